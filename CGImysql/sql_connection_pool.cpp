@@ -1,18 +1,28 @@
 #include <mysql/mysql.h>
+#include <mysql/errmsg.h>
 #include <stdio.h>
 #include <string>
 #include <string.h>
 #include <stdlib.h>
 #include <list>
 #include <pthread.h>
+#include <time.h>
 #include <iostream>
 #include "sql_connection_pool.h"
 
 using namespace std;
 
 connection_pool::connection_pool() {
+    m_MinConn = 0;
+    m_MaxConn = 0;
     m_CurConn = 0;
-    m_FreeConn = 0;
+    m_TotalConn = 0;
+    m_acquire_timeout = ACQUIRE_TIMEOUT_MS;
+    m_validate_idle = VALIDATE_IDLE_MS;
+    m_max_idle = MAX_IDLE_MS;
+    m_destroyed = false;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_close_log = 0;
 }
 
 //使用局部静态变量懒汉模式创建连接池
@@ -21,87 +31,265 @@ connection_pool* connection_pool::GetInstance() {
     return &connPool;
 }
 
+int64_t connection_pool::now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool connection_pool::broken(MYSQL* con) {
+    unsigned int err = mysql_errno(con);
+    return err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST;
+}
+
+int connection_pool::GetMaxIdle() {
+    return m_max_idle;
+}
+
+void connection_pool::SetTimeouts(int acquire_ms, int validate_idle_ms, int max_idle_ms) {
+    m_acquire_timeout = acquire_ms;
+    m_validate_idle = validate_idle_ms;
+    m_max_idle = max_idle_ms;
+}
+
 //构造初始化
-void connection_pool::init(string url, string User, string PassWord, string DBName, int Port, int MaxConn, int close_log) {
+void connection_pool::init(string url, string User, string PassWord, string DBName, int Port, int MinConn, int MaxConn, int close_log) {
     //初始化数据库信息
     m_url = url;
-    m_Port = Port;
+    m_Port = to_string(Port);
     m_User = User;
+    m_PassWord = PassWord;
     m_DatabaseName = DBName;
     m_close_log = close_log;
-    //创建MaxConn条数据库连接
-    for (int i = 0; i < MaxConn; ++i) {
-        MYSQL* con = NULL;
-        con = mysql_init(con);
+    m_MaxConn = MaxConn;
+    m_MinConn = MinConn < MaxConn ? MinConn : MaxConn;
+    //先建立MinConn条数据库连接,失败时不退出,之后取连接时再建立
+    for (int i = 0; i < m_MinConn; ++i) {
+        MYSQL* con = Connect();
         if (con == NULL) {
-            LOG_ERROR("Mysql Error");
-            exit(1);
+            LOG_ERROR("Mysql Error: only %d of %d connections opened", i, m_MinConn);
+            break;
         }
-        con = mysql_real_connect(con, url.c_str(), User.c_str(), PassWord.c_str(), DBName.c_str(), Port, NULL, 0);
-        if (con == NULL) {
-            LOG_ERROR("Mysql Error");
-            exit(1);
-        }
-        connList.push_back(con);
-        ++m_FreeConn;
+        idle_conn c = {con, now_us() / 1000};
+        connList.push_back(c);
+        ++m_TotalConn;
+    }
+}
 
+MYSQL* connection_pool::Connect() {
+    MYSQL* con = mysql_init(NULL);
+    if (con == NULL) {
+        LOG_ERROR("Mysql Error");
+        return NULL;
+    }
+    unsigned int timeout = CONNECT_TIMEOUT_S;
+    mysql_options(con, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    if (!mysql_real_connect(con, m_url.c_str(), m_User.c_str(), m_PassWord.c_str(), m_DatabaseName.c_str(),
+                            atoi(m_Port.c_str()), NULL, 0)) {
+        LOG_ERROR("Mysql Error: %s", mysql_error(con));
+        mysql_close(con);
+        return NULL;
     }
-    reserve = sem(m_FreeConn);
-    m_MaxConn = m_FreeConn;
+    //语句缓存按连接的地址登记,新连接可能复用了已关闭连接的地址,总是换上新的缓存,不沿用旧连接上的语句
+    stmt_cache* fresh = new stmt_cache(con, m_close_log);
+    m_stmt_lock.lock();
+    stmt_cache*& stmts = m_stmts[con];
+    stmt_cache* stale = stmts;
+    stmts = fresh;
+    m_stmt_lock.unlock();
+    delete stale;
+    return con;
+}
+
+void connection_pool::Close(MYSQL* con) {
+    m_stmt_lock.lock();
+    map<MYSQL*, stmt_cache*>::iterator it = m_stmts.find(con);
+    stmt_cache* stmts = NULL;
+    if (it != m_stmts.end()) {
+        stmts = it->second;
+        m_stmts.erase(it);
+    }
+    m_stmt_lock.unlock();
+    delete stmts;
+    mysql_close(con);
+}
+
+MYSQL_STMT* connection_pool::Prepare(MYSQL* con, const string& sql) {
+    m_stmt_lock.lock();
+    map<MYSQL*, stmt_cache*>::iterator it = m_stmts.find(con);
+    stmt_cache* cache = it != m_stmts.end() ? it->second : NULL;
+    m_stmt_lock.unlock();
+    if (!cache) {
+        LOG_ERROR("prepare on a connection not opened by the pool");
+        return NULL;
+    }
+    return cache->get(sql);
 }
 
 //当有请求时，从数据库连接池中返回一个可用连接，更新使用和空闲连接数
+//优先借出最近归还的空闲连接;没有空闲连接时在最大连接数以内新建,否则等待归还,最多等待m_acquire_timeout毫秒
+//建立连接和ping都在锁外进行,名额在锁内预先占住
 MYSQL* connection_pool::GetConnection() {
-    MYSQL* con = NULL;
-    if (connList.size() == 0) {
-        return NULL;
+    int64_t start = now_us();
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += m_acquire_timeout / 1000;
+    deadline.tv_nsec += (long)(m_acquire_timeout % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
     }
-    //取出连接，信号量原子减1，为0则等待
-    reserve.wait();
+
     lock.lock();
+    bool waited = false;
+    while (!m_destroyed && connList.empty() && m_TotalConn >= m_MaxConn) {
+        if (now_us() - start >= m_acquire_timeout * 1000LL) {
+            ++m_stats.timeouts;
+            lock.unlock();
+            LOG_WARN("no mysql connection available in %d ms", m_acquire_timeout);
+            return NULL;
+        }
+        waited = true;
+        ++m_stats.waiters;
+        m_available.timewait(lock.get(), deadline);
+        --m_stats.waiters;
+    }
+    if (m_destroyed) {
+        lock.unlock();
+        return NULL;
+    }
+    int64_t now = now_us();
+    if (waited) {
+        uint64_t wait = now - start;
+        ++m_stats.waited;
+        m_stats.wait_us += wait;
+        if (wait > m_stats.max_wait_us) {
+            m_stats.max_wait_us = wait;
+        }
+    }
+    ++m_stats.acquired;
+    ++m_CurConn;
 
-    con = connList.front();
-    connList.pop_front();
+    MYSQL* con = NULL;
+    bool validate = false;
+    if (!connList.empty()) {
+        con = connList.back().con;
+        validate = now / 1000 - connList.back().since >= m_validate_idle;
+        connList.pop_back();
+    }
+    else {
+        ++m_TotalConn;
+    }
+    lock.unlock();
 
-    ++m_CurConn;
-    --m_FreeConn;
+    bool reconnect = false;
+    if (con && validate && mysql_ping(con) != 0) {
+        LOG_WARN("mysql connection lost: %s", mysql_error(con));
+        Close(con);
+        con = NULL;
+        reconnect = true;
+    }
+    if (con) {
+        return con;
+    }
+    con = Connect();
+
+    lock.lock();
+    if (con) {
+        m_stats.reconnects += reconnect;
+    }
+    else {
+        //交还名额,让等待的线程自己再试
+        ++m_stats.connect_failures;
+        --m_stats.acquired;
+        --m_CurConn;
+        --m_TotalConn;
+        m_available.signal();
+    }
     lock.unlock();
     return con;
 }
 
 //释放当前使用的连接
+//已断开的连接直接关闭;超出最小连接数时顺便关闭一条空闲过久的连接
 bool connection_pool::ReleaseConnection(MYSQL* con) {
     if (con == NULL) {
         return false;
     }
+    bool lost = broken(con);
+    MYSQL* expired = NULL;
     lock.lock();
-    connList.push_back(con);
-    ++m_FreeConn;
     --m_CurConn;
+    if (lost || m_destroyed) {
+        --m_TotalConn;
+        m_stats.broken += lost;
+    }
+    else {
+        int64_t now = now_us() / 1000;
+        idle_conn c = {con, now};
+        connList.push_back(c);
+        con = NULL;
+        if (m_TotalConn > m_MinConn && now - connList.front().since >= m_max_idle) {
+            expired = connList.front().con;
+            connList.pop_front();
+            --m_TotalConn;
+        }
+    }
+    m_available.signal();
     lock.unlock();
-    reserve.post();
+
+    if (con) {
+        if (lost) {
+            LOG_WARN("mysql connection lost: %s", mysql_error(con));
+        }
+        Close(con);
+    }
+    if (expired) {
+        Close(expired);
+    }
     return true;
 }
 
-//销毁数据库连接池
+//销毁数据库连接池,借出的连接在归还时关闭
 void connection_pool::DestroyPool() {
     lock.lock();
-    if (connList.size() > 0) {
-        list<MYSQL*>::iterator it;
-        for (it = connList.begin(); it != connList.end(); ++it) {
-            MYSQL* con = *it;
-            mysql_close(con);
-        }
-        m_CurConn = 0;
-        m_FreeConn = 0;
-        connList.clear();
-    }
+    list<idle_conn> conns;
+    conns.swap(connList);
+    m_TotalConn -= conns.size();
+    m_destroyed = true;
+    m_available.broadcast();
     lock.unlock();
+    list<idle_conn>::iterator it;
+    for (it = conns.begin(); it != conns.end(); ++it) {
+        Close(it->con);
+    }
 }
 
 //当前空闲的连接数
 int connection_pool::GetFreeConn() {
-    return  this->m_FreeConn; 
+    lock.lock();
+    int free = connList.size();
+    lock.unlock();
+    return free;
+}
+
+connection_pool::stats connection_pool::GetStats() {
+    lock.lock();
+    stats s = m_stats;
+    s.total = m_TotalConn;
+    s.in_use = m_CurConn;
+    s.idle = connList.size();
+    lock.unlock();
+    return s;
+}
+
+void connection_pool::LogStats() {
+    stats s = GetStats();
+    LOG_INFO("mysql pool: %d connections (%d in use, %d idle, %d waiters), %llu acquired, %llu waited (%llu us total, "
+             "%llu us max), %llu timeouts, %llu reconnects, %llu broken, %llu connect failures", s.total, s.in_use, s.idle,
+             s.waiters, (unsigned long long)s.acquired, (unsigned long long)s.waited, (unsigned long long)s.wait_us,
+             (unsigned long long)s.max_wait_us, (unsigned long long)s.timeouts, (unsigned long long)s.reconnects,
+             (unsigned long long)s.broken, (unsigned long long)s.connect_failures);
 }
 
 connection_pool::~connection_pool() {
@@ -117,6 +305,3 @@ connectionRAII::connectionRAII(MYSQL** SQL, connection_pool* connPool) {
 connectionRAII::~connectionRAII() {
     poolRAII->ReleaseConnection(conRAII);
 }
-
-
-
@@ -2,7 +2,9 @@
 #define SQL_CONNECION_POOL_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include <list>
+#include <map>
 #include <mysql/mysql.h>
 #include <error.h>
 #include <string.h>
@@ -10,32 +12,85 @@
 #include <string>
 #include "../lock/locker.h"
 #include "../log/log.h"
+#include "stmt_cache.h"
 
 using namespace std;
 
+//连接数在最小值和最大值之间伸缩:启动时建立最小连接数条,不够用时按需建立,超出最小值的连接空闲太久后关闭
+//借出空闲了一段时间的连接前先ping,连接失效时重新建立;归还时最后一次操作报告连接断开的,关闭后由下次借出按需重建
+//数据库不可用时不退出进程,取连接在超时或无法建立连接时返回NULL,由调用者按错误处理
 class connection_pool
 {
 
 public: 
-    MYSQL* GetConnection();                 //获取数据库连接    
-    int GetFreeConn();                      //获取连接 
+    static const int ACQUIRE_TIMEOUT_MS = 1000;     //没有空闲连接且已达最大连接数时,取连接最多等待的时间
+    static const int VALIDATE_IDLE_MS = 5000;       //空闲超过该时间的连接借出前先ping
+    static const int MAX_IDLE_MS = 60000;           //超出最小连接数的连接空闲超过该时间后关闭
+    static const int CONNECT_TIMEOUT_S = 3;         //建立连接的超时时间
+
+    //连接池的统计
+    struct stats {
+        int total;              //已建立和正在建立的连接数
+        int in_use;             //借出的连接数
+        int idle;               //空闲的连接数
+        int waiters;            //正在等待连接的线程数
+        uint64_t acquired;      //借出的次数
+        uint64_t waited;        //其中需要等待的次数
+        uint64_t wait_us;       //等待的总时间
+        uint64_t max_wait_us;   //最长的一次等待
+        uint64_t timeouts;      //等待超时的次数
+        uint64_t reconnects;    //ping失败后重建连接的次数
+        uint64_t broken;        //归还时已断开而关闭的连接数
+        uint64_t connect_failures;  //建立连接失败的次数
+    };
+
+    MYSQL* GetConnection();                 //获取数据库连接,超时或无法建立连接时返回NULL
+    int GetFreeConn();                      //获取空闲的连接数
     bool ReleaseConnection(MYSQL* conn);    //释放连接
     void DestroyPool();                     //销毁所有连接
+    stats GetStats();
+    void LogStats();                        //在日志中记录统计,收到SIGUSR1和退出时调用
+    //调整上面三个时间(毫秒),默认值为ACQUIRE_TIMEOUT_MS、VALIDATE_IDLE_MS和MAX_IDLE_MS;在init之前调用,测试中用较短的时间
+    void SetTimeouts(int acquire_ms, int validate_idle_ms, int max_idle_ms);
+    int GetMaxIdle();                       //超出最小连接数的连接空闲多久后关闭,毫秒
+    //按连接池的参数建立一条新连接并登记它的预处理语句缓存,不计入连接池,失败时返回NULL
+    MYSQL* Connect();
+    //关闭Connect建立的连接,先关闭其上的预处理语句
+    void Close(MYSQL* con);
+    //返回连接con上sql对应的预处理语句,每条连接上只预处理一次,失败时返回NULL
+    //只能由持有该连接的线程调用,语句在下次归还连接前使用;con必须由Connect建立且还没有Close
+    MYSQL_STMT* Prepare(MYSQL* con, const string& sql);
     //单例模式
     static connection_pool* GetInstance();
 
-    void init(string url, string User, string PassWord, string DataBaseName, int Port, int MaxConn, int close_log);
+    void init(string url, string User, string PassWord, string DataBaseName, int Port, int MinConn, int MaxConn, int close_log);
 
 private:
     connection_pool();
     ~connection_pool();
 
+    struct idle_conn {
+        MYSQL* con;
+        int64_t since;      //归还的时间,毫秒
+    };
+
+    static int64_t now_us();        //单调时钟
+    static bool broken(MYSQL* con); //最后一次操作报告与服务器的连接已断开
+
+    int m_MinConn;      //最小连接数
     int m_MaxConn;      //最大连接数
     int m_CurConn;      //当前已使用的连接数
-    int m_FreeConn;     //当前空闲的连接数
+    int m_TotalConn;    //已建立和正在建立的连接数,不超过m_MaxConn
+    int m_acquire_timeout;      //以下三个为毫秒
+    int m_validate_idle;
+    int m_max_idle;
+    bool m_destroyed;
     locker lock;
-    list<MYSQL*> connList;     //连接池
-    sem reserve;            //信号量初始化为数据库的连接总数
+    cond m_available;           //有连接归还或可以新建连接,等待取连接的线程
+    list<idle_conn> connList;   //空闲连接,最近归还的在末尾,借出时从末尾取,空闲最久的在开头
+    stats m_stats;              //计数部分,受lock保护
+    locker m_stmt_lock;                     //保护m_stmts,与借出和归还的锁分开
+    map<MYSQL*, stmt_cache*> m_stmts;       //各连接上的预处理语句,Connect时创建,Close时删除
 
 public:
     string m_url;          //主机地址
@@ -0,0 +1,30 @@
+#include "stmt_cache.h"
+#include "../log/log.h"
+
+stmt_cache::stmt_cache(MYSQL* con, int close_log): m_con(con), m_close_log(close_log) {}
+
+stmt_cache::~stmt_cache() {
+    std::map<std::string, MYSQL_STMT*>::iterator it;
+    for (it = m_stmts.begin(); it != m_stmts.end(); ++it) {
+        mysql_stmt_close(it->second);
+    }
+}
+
+MYSQL_STMT* stmt_cache::get(const std::string& sql) {
+    std::map<std::string, MYSQL_STMT*>::iterator it = m_stmts.find(sql);
+    if (it != m_stmts.end()) {
+        return it->second;
+    }
+    MYSQL_STMT* stmt = mysql_stmt_init(m_con);
+    if (!stmt) {
+        LOG_ERROR("mysql_stmt_init failed: %s", mysql_error(m_con));
+        return NULL;
+    }
+    if (mysql_stmt_prepare(stmt, sql.c_str(), sql.size())) {
+        LOG_ERROR("prepare failed: %s", mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return NULL;
+    }
+    m_stmts[sql] = stmt;
+    return stmt;
+}
@@ -0,0 +1,24 @@
+#ifndef STMT_CACHE_H
+#define STMT_CACHE_H
+
+#include <mysql/mysql.h>
+#include <map>
+#include <string>
+
+//一个连接上的预处理语句:同一SQL文本第一次使用时在服务器端预处理,之后只绑定参数执行,服务器不再解析和生成执行计划
+//只由借出该连接的线程使用,不加锁;语句依附于连接,由连接池在建立连接时创建,关闭连接前析构
+class stmt_cache {
+public:
+    stmt_cache(MYSQL* con, int close_log);
+    ~stmt_cache();
+
+    //返回sql对应的预处理语句,第一次使用时预处理,失败时返回NULL
+    MYSQL_STMT* get(const std::string& sql);
+
+private:
+    MYSQL* m_con;
+    std::map<std::string, MYSQL_STMT*> m_stmts;
+    int m_close_log;
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "user_store.h"
+
+user_store::user user_store::m_erased;
+
+//使用局部静态变量懒汉模式创建用户表
+user_store* user_store::get_instance() {
+    static user_store instance;
+    return &instance;
+}
+
+user_store::user_store(): m_size(0) {
+    for (int i = 0; i < SHARD_NUM; ++i) {
+        m_shards[i].current.store(new_table(INITIAL_SLOTS), std::memory_order_relaxed);
+        m_shards[i].count = 0;
+    }
+}
+
+user_store::~user_store() {
+    for (int i = 0; i < SHARD_NUM; ++i) {
+        shard& s = m_shards[i];
+        table* t = s.current.load(std::memory_order_relaxed);
+        for (size_t j = 0; j <= t->mask; ++j) {
+            user* u = t->slots[j].load(std::memory_order_relaxed);
+            if (u != &m_erased) {
+                free(u);
+            }
+        }
+        for (size_t j = 0; j < s.erased.size(); ++j) {
+            free(s.erased[j]);
+        }
+        s.retired.push_back(t);
+        for (size_t j = 0; j < s.retired.size(); ++j) {
+            delete[] s.retired[j]->slots;
+            delete s.retired[j];
+        }
+    }
+}
+
+//FNV-1a,高位选分片,低位选槽
+uint64_t user_store::hash(const char* name) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char* p = (const unsigned char*)name; *p; ++p) {
+        h = (h ^ *p) * 1099511628211ULL;
+    }
+    return h ^ (h >> 29);
+}
+
+user_store::table* user_store::new_table(size_t slots) {
+    table* t = new table;
+    t->mask = slots - 1;
+    t->slots = new std::atomic<user*>[slots];
+    for (size_t i = 0; i < slots; ++i) {
+        t->slots[i].store(NULL, std::memory_order_relaxed);
+    }
+    return t;
+}
+
+void user_store::place(table* t, user* u) {
+    size_t i = u->hash & t->mask;
+    while (t->slots[i].load(std::memory_order_relaxed)) {
+        i = (i + 1) & t->mask;
+    }
+    t->slots[i].store(u, std::memory_order_relaxed);
+}
+
+//线性探测直到空槽,删除只留下标记,所以遇到空槽就说明不存在
+const user_store::user* user_store::find(const char* name) const {
+    uint64_t h = hash(name);
+    const shard& s = m_shards[h >> 58];
+    const table* t = s.current.load(std::memory_order_acquire);
+    for (size_t i = h & t->mask;; i = (i + 1) & t->mask) {
+        const user* u = t->slots[i].load(std::memory_order_acquire);
+        if (!u) {
+            return NULL;
+        }
+        if (u != &m_erased && u->hash == h && strcmp(u->name, name) == 0) {
+            return u;
+        }
+    }
+}
+
+bool user_store::contains(const char* name) const {
+    return find(name) != NULL;
+}
+
+bool user_store::check(const char* name, const char* password) const {
+    const user* u = find(name);
+    return u && strcmp(u->password, password) == 0;
+}
+
+bool user_store::insert(const char* name, const char* password) {
+    uint64_t h = hash(name);
+    shard& s = m_shards[h >> 58];
+    s.lock.lock();
+    table* t = s.current.load(std::memory_order_relaxed);
+    size_t i = h & t->mask;
+    size_t reuse = 0;
+    bool has_reuse = false;     //探测路径上的第一个删除标记,确认用户不存在后放在这里
+    for (user* u; (u = t->slots[i].load(std::memory_order_relaxed)); i = (i + 1) & t->mask) {
+        if (u == &m_erased) {
+            if (!has_reuse) {
+                reuse = i;
+                has_reuse = true;
+            }
+            continue;
+        }
+        if (u->hash == h && strcmp(u->name, name) == 0) {
+            s.lock.unlock();
+            return false;
+        }
+    }
+    if (has_reuse) {
+        i = reuse;
+    }
+    size_t name_len = strlen(name);
+    size_t password_len = strlen(password);
+    user* u = (user*)malloc(sizeof(user) + name_len + password_len + 1);
+    u->hash = h;
+    memcpy(u->name, name, name_len + 1);
+    u->password = u->name + name_len + 1;
+    memcpy((char*)u->password, password, password_len + 1);
+    //release保证读者看到槽中的指针时,条目的内容已经写完
+    t->slots[i].store(u, std::memory_order_release);
+    //装载率超过1/2时扩容,探测长度保持在很小的范围;复用删除标记不增加占用的槽数
+    if (!has_reuse && ++s.count * 2 > t->mask + 1) {
+        grow(s);
+    }
+    s.lock.unlock();
+    m_size.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool user_store::erase(const char* name) {
+    uint64_t h = hash(name);
+    shard& s = m_shards[h >> 58];
+    s.lock.lock();
+    table* t = s.current.load(std::memory_order_relaxed);
+    for (size_t i = h & t->mask;; i = (i + 1) & t->mask) {
+        user* u = t->slots[i].load(std::memory_order_relaxed);
+        if (!u) {
+            s.lock.unlock();
+            return false;
+        }
+        if (u != &m_erased && u->hash == h && strcmp(u->name, name) == 0) {
+            t->slots[i].store(&m_erased, std::memory_order_release);
+            s.erased.push_back(u);
+            s.lock.unlock();
+            m_size.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+//调用时持有分片的锁,新表中不再放入删除标记
+void user_store::grow(shard& s) {
+    table* old = s.current.load(std::memory_order_relaxed);
+    table* t = new_table((old->mask + 1) * 2);
+    s.count = 0;
+    for (size_t i = 0; i <= old->mask; ++i) {
+        user* u = old->slots[i].load(std::memory_order_relaxed);
+        if (u && u != &m_erased) {
+            place(t, u);
+            ++s.count;
+        }
+    }
+    s.current.store(t, std::memory_order_release);
+    s.retired.push_back(old);
+}
@@ -0,0 +1,70 @@
+#ifndef USER_STORE_H
+#define USER_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+#include "../lock/locker.h"
+
+//用户表:启动时从数据库读入,注册时插入,登录时查询
+//按用户名的哈希分成SHARD_NUM个分片,每个分片是一个开放寻址的哈希表,槽中存放指向用户条目的原子指针
+//条目发布后不再修改:查询不加锁,只用acquire读取槽和表指针;插入和删除只锁所在的分片
+//删除只用于撤销写入数据库失败的注册:槽中换成删除标记,探测时跳过,插入时复用;读者可能还在使用被删除的条目,留到析构时释放
+//扩容时新建两倍大小的槽数组,把条目指针重新放入后一次性发布,旧的槽数组可能仍有读者在用,留到析构时释放
+class user_store {
+public:
+    //单例模式
+    static user_store* get_instance();
+
+    //用户名不存在时插入,返回是否插入;已存在时不修改密码
+    bool insert(const char* name, const char* password);
+    //删除用户,返回用户是否存在
+    bool erase(const char* name);
+    //用户名存在且密码一致
+    bool check(const char* name, const char* password) const;
+    bool contains(const char* name) const;
+    size_t size() const {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const int SHARD_NUM = 64;            //必须是2的幂
+    static const int INITIAL_SLOTS = 64;        //每个分片初始的槽数,必须是2的幂
+
+    struct user {
+        uint64_t hash;
+        const char* password;
+        char name[1];       //用户名和密码依次存放在条目末尾
+    };
+
+    struct table {
+        size_t mask;        //槽数减1
+        std::atomic<user*>* slots;
+    };
+
+    struct shard {
+        std::atomic<table*> current;
+        size_t count;               //已占用的槽数,包括删除标记,受lock保护
+        locker lock;
+        std::vector<table*> retired;    //扩容替换下来的槽数组,受lock保护
+        std::vector<user*> erased;      //被删除的条目,受lock保护
+    };
+
+    user_store();
+    ~user_store();
+
+    static uint64_t hash(const char* name);
+    static table* new_table(size_t slots);
+    static void place(table* t, user* u);       //扩容时放入条目,新表还没有发布
+    const user* find(const char* name) const;
+    void grow(shard& s);
+
+    static user m_erased;       //删除标记
+
+    shard m_shards[SHARD_NUM];
+    std::atomic<size_t> m_size;
+};
+
+#endif
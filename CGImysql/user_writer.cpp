@@ -0,0 +1,210 @@
+#include <mysql/mysql.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "user_writer.h"
+#include "../log/log.h"
+
+//使用局部静态变量懒汉模式创建后台写入
+user_writer* user_writer::get_instance() {
+    static user_writer instance;
+    return &instance;
+}
+
+static_assert(1 << (user_writer::INSERT_SIZES - 1) == user_writer::MAX_BATCH, "the largest INSERT must hold MAX_BATCH rows");
+
+user_writer::user_writer(): m_pool(NULL), m_mysql(NULL), m_ack_mode(ACK_QUEUED), m_started(false), m_next_seq(1), m_done_seq(0),
+                            m_stop(false), m_close_log(0) {
+    for (int i = 0; i < INSERT_SIZES; ++i) {
+        std::string& sql = m_insert_sql[i];
+        sql = "INSERT IGNORE INTO user(username, passwd) VALUES(?,?)";
+        for (int j = 1; j < (1 << i); ++j) {
+            sql += ",(?,?)";
+        }
+    }
+    memset(m_bind, 0, sizeof(m_bind));
+    for (int i = 0; i < 2 * MAX_BATCH; ++i) {
+        m_bind[i].buffer_type = MYSQL_TYPE_STRING;
+        m_bind[i].length = &m_length[i];
+    }
+}
+
+user_writer::~user_writer() {
+    stop();
+}
+
+void user_writer::init(connection_pool* pool, int ack_mode, int close_log) {
+    m_pool = pool;
+    m_ack_mode = ack_mode;
+    m_close_log = close_log;
+    if (pthread_create(&m_thread, NULL, worker, this) != 0) {
+        LOG_ERROR("create user writer thread failed");
+        return;
+    }
+    m_started = true;
+}
+
+void* user_writer::worker(void* arg) {
+    ((user_writer*)arg)->run();
+    return NULL;
+}
+
+//队列满时等待后台线程取走一批;后台线程没有启动时直接按写入失败处理
+bool user_writer::submit(const char* name, const char* password) {
+    m_lock.lock();
+    while (m_started && !m_stop && m_queue.size() >= MAX_QUEUE) {
+        m_not_full.wait(m_lock.get());
+    }
+    if (!m_started || m_stop) {
+        m_lock.unlock();
+        LOG_ERROR("user writer is not running, %s is not saved", name);
+        return false;
+    }
+    pending p;
+    p.seq = m_next_seq++;
+    p.name = name;
+    p.password = password;
+    m_queue.push_back(p);
+    m_not_empty.signal();
+    if (m_ack_mode == ACK_QUEUED) {
+        m_lock.unlock();
+        return true;
+    }
+    while (m_done_seq < p.seq) {
+        m_written.wait(m_lock.get());
+    }
+    bool ok = m_failed.erase(p.seq) == 0;
+    m_lock.unlock();
+    return ok;
+}
+
+void user_writer::stop() {
+    m_lock.lock();
+    if (!m_started || m_stop) {
+        m_lock.unlock();
+        return;
+    }
+    m_stop = true;
+    m_not_empty.signal();
+    m_not_full.broadcast();
+    m_lock.unlock();
+    pthread_join(m_thread, NULL);
+}
+
+void user_writer::run() {
+    std::deque<pending> batch;
+    while (true) {
+        m_lock.lock();
+        while (m_queue.empty() && !m_stop) {
+            if (!m_mysql) {
+                m_not_empty.wait(m_lock.get());
+                continue;
+            }
+            //专用连接与池中超出最小连接数的连接一样,空闲超过连接池的最长空闲时间后关闭,下次写入前重新连接
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            int idle = m_pool->GetMaxIdle();
+            deadline.tv_sec += idle / 1000;
+            deadline.tv_nsec += (long)(idle % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec += 1;
+                deadline.tv_nsec -= 1000000000;
+            }
+            if (!m_not_empty.timewait(m_lock.get(), deadline) && m_queue.empty() && !m_stop) {
+                disconnect();
+            }
+        }
+        if (m_queue.empty()) {
+            m_lock.unlock();
+            disconnect();
+            break;
+        }
+        size_t n = m_queue.size() < (size_t)MAX_BATCH ? m_queue.size() : MAX_BATCH;
+        batch.assign(m_queue.begin(), m_queue.begin() + n);
+        m_queue.erase(m_queue.begin(), m_queue.begin() + n);
+        m_not_full.broadcast();
+        m_lock.unlock();
+
+        bool ok = write_batch(batch);
+
+        m_lock.lock();
+        m_done_seq = batch.back().seq;
+        if (!ok && m_ack_mode == ACK_COMMITTED) {
+            for (size_t i = 0; i < batch.size(); ++i) {
+                m_failed.insert(batch[i].seq);
+            }
+        }
+        m_written.broadcast();
+        m_lock.unlock();
+    }
+}
+
+bool user_writer::write_batch(const std::deque<pending>& batch) {
+    int delay = RETRY_DELAY_MS;
+    for (int attempt = 0; attempt <= MAX_RETRY; ++attempt) {
+        if (attempt > 0) {
+            usleep(delay * 1000);
+            delay *= 2;
+        }
+        if (!m_mysql && !connect()) {
+            LOG_WARN("user writer: connect failed, attempt %d", attempt + 1);
+            continue;
+        }
+        if (insert(batch)) {
+            return true;
+        }
+        LOG_WARN("user writer: INSERT of %d users failed, attempt %d", (int)batch.size(), attempt + 1);
+        //连接可能已经断开,下次重试时重新连接
+        disconnect();
+    }
+    LOG_ERROR("user writer: gave up %d users, first is %s", (int)batch.size(), batch.front().name.c_str());
+    return false;
+}
+
+//一批的行数按二进制位拆成几段,从大到小依次用对应行数的预处理语句写入;重试时整批重写,已写入的用户被IGNORE忽略
+//数据库中已有的同名用户(例如其他实例注册的)被忽略,不影响同一批中的其他用户
+bool user_writer::insert(const std::deque<pending>& batch) {
+    size_t first = 0;
+    for (int size = INSERT_SIZES - 1; size >= 0; --size) {
+        if (batch.size() - first >= ((size_t)1 << size)) {
+            if (!insert(batch, first, size)) {
+                return false;
+            }
+            first += (size_t)1 << size;
+        }
+    }
+    return true;
+}
+
+bool user_writer::insert(const std::deque<pending>& batch, size_t first, int size) {
+    MYSQL_STMT* stmt = m_pool->Prepare(m_mysql, m_insert_sql[size]);
+    if (!stmt) {
+        return false;
+    }
+    int rows = 1 << size;
+    for (int i = 0; i < rows; ++i) {
+        const pending& p = batch[first + i];
+        m_bind[2 * i].buffer = (void*)p.name.data();
+        m_bind[2 * i].buffer_length = m_length[2 * i] = p.name.size();
+        m_bind[2 * i + 1].buffer = (void*)p.password.data();
+        m_bind[2 * i + 1].buffer_length = m_length[2 * i + 1] = p.password.size();
+    }
+    if (mysql_stmt_bind_param(stmt, m_bind) || mysql_stmt_execute(stmt)) {
+        LOG_WARN("user writer: %s", mysql_stmt_error(stmt));
+        return false;
+    }
+    return true;
+}
+
+bool user_writer::connect() {
+    m_mysql = m_pool->Connect();
+    return m_mysql != NULL;
+}
+
+void user_writer::disconnect() {
+    if (m_mysql) {
+        m_pool->Close(m_mysql);
+        m_mysql = NULL;
+    }
+}
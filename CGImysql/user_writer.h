@@ -0,0 +1,82 @@
+#ifndef USER_WRITER_H
+#define USER_WRITER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <deque>
+#include <set>
+#include <string>
+
+#include "../lock/locker.h"
+#include "sql_connection_pool.h"
+
+//注册用户的后台写入:注册先在用户表中生效,再排队交给后台线程,注册请求不再等待数据库往返
+//后台线程每次取出队列中的全部用户(最多MAX_BATCH个)合并成多行INSERT,写入期间到达的注册在下一批写入
+//INSERT使用预处理语句,按2的幂的行数各准备一条,一批按行数的二进制位拆开执行,最多INSERT_SIZES次,不拼接和转义SQL文本
+//后台线程使用自己的数据库连接,按连接池的参数建立:ACK_COMMITTED时工作线程可能占着池中的连接等待写入结果,不能再从池中取
+//该连接空闲超过连接池的最长空闲时间或停止时关闭
+//写入失败时重新连接并按指数退避重试,超过MAX_RETRY次后放弃并记录日志;退出时先写完队列中剩余的用户
+class user_writer {
+public:
+    enum ACK_MODE {
+        ACK_QUEUED = 0,     //进入队列即返回注册成功
+        ACK_COMMITTED       //等所在的批次写入数据库后才返回,最终写入失败时返回注册失败
+    };
+
+    static const int MAX_QUEUE = 4096;      //队列容量,满时注册请求等待后台线程取走一批
+    static const int MAX_BATCH = 256;       //一条INSERT最多包含的用户数
+    static const int MAX_RETRY = 5;         //一批写入失败后的最大重试次数
+    static const int RETRY_DELAY_MS = 100;  //第一次重试前等待的时间,之后每次加倍
+    static const int INSERT_SIZES = 9;      //预处理的INSERT的种数,第i种插入2^i行,最大的一种等于MAX_BATCH
+
+    //单例模式
+    static user_writer* get_instance();
+
+    //启动后台线程,按pool的参数建立数据库连接
+    void init(connection_pool* pool, int ack_mode, int close_log);
+    //排队写入一个新用户,ACK_COMMITTED时等待写入结果,返回注册是否成功
+    bool submit(const char* name, const char* password);
+    //写完队列中的用户后停止后台线程
+    void stop();
+
+private:
+    struct pending {
+        uint64_t seq;
+        std::string name;
+        std::string password;
+    };
+
+    user_writer();
+    ~user_writer();
+
+    static void* worker(void* arg);
+    void run();
+    bool write_batch(const std::deque<pending>& batch);     //写入一批,失败时重试
+    bool insert(const std::deque<pending>& batch);
+    bool insert(const std::deque<pending>& batch, size_t first, int size);     //用第size种INSERT写入从first开始的2^size个用户
+    bool connect();
+    void disconnect();
+
+    connection_pool* m_pool;
+    MYSQL* m_mysql;             //后台线程专用的连接,为NULL时下次写入前连接
+    int m_ack_mode;
+    std::string m_insert_sql[INSERT_SIZES];     //各种行数的INSERT语句
+    MYSQL_BIND m_bind[2 * MAX_BATCH];           //INSERT的参数,依次为各行的用户名和密码,只由后台线程使用
+    unsigned long m_length[2 * MAX_BATCH];
+    pthread_t m_thread;
+    bool m_started;
+
+    locker m_lock;              //保护以下成员
+    cond m_not_empty;           //有用户排队或要求停止,后台线程等待
+    cond m_not_full;            //队列有空位,注册请求等待
+    cond m_written;             //一批写入结束,ACK_COMMITTED的注册请求等待
+    std::deque<pending> m_queue;
+    uint64_t m_next_seq;        //下一个排队用户的序号
+    uint64_t m_done_seq;        //该序号之前的用户都已写入或放弃
+    std::set<uint64_t> m_failed;    //放弃写入、还没有被等待者取走结果的用户序号,只在ACK_COMMITTED时记录
+    bool m_stop;
+
+    int m_close_log;
+};
+
+#endif
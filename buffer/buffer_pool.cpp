@@ -0,0 +1,74 @@
+#include <stdlib.h>
+#include "buffer_pool.h"
+
+buffer_pool::buffer_pool() {
+    for (int i = 0; i < CLASS_NUM; ++i) {
+        m_free[i] = NULL;
+        m_free_count[i] = 0;
+    }
+}
+
+buffer_pool::~buffer_pool() {
+    for (int i = 0; i < CLASS_NUM; ++i) {
+        while (m_free[i]) {
+            free_node* node = m_free[i];
+            m_free[i] = node->next;
+            free(node);
+        }
+    }
+}
+
+//使用局部静态变量懒汉模式创建缓冲区池
+buffer_pool* buffer_pool::get_instance() {
+    static buffer_pool pool;
+    return &pool;
+}
+
+//容量不小于size的最小一级
+int buffer_pool::size_class(int size) {
+    int index = 0;
+    int cap = MIN_SIZE;
+    while (cap < size) {
+        cap <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+char* buffer_pool::acquire(int size, int* cap) {
+    if (size > MAX_SIZE) {
+        return NULL;
+    }
+    int index = size_class(size);
+    *cap = MIN_SIZE << index;
+
+    free_node* node = NULL;
+    m_lock[index].lock();
+    if (m_free[index]) {
+        node = m_free[index];
+        m_free[index] = node->next;
+        --m_free_count[index];
+    }
+    m_lock[index].unlock();
+    if (node) {
+        return (char*)node;
+    }
+    return (char*)malloc(*cap);
+}
+
+void buffer_pool::release(char* buf, int cap) {
+    if (!buf) {
+        return;
+    }
+    int index = size_class(cap);
+    m_lock[index].lock();
+    if (m_free_count[index] < MAX_FREE_BYTES / cap) {
+        free_node* node = (free_node*)buf;
+        node->next = m_free[index];
+        m_free[index] = node;
+        ++m_free_count[index];
+        buf = NULL;
+    }
+    m_lock[index].unlock();
+    free(buf);
+}
@@ -0,0 +1,40 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include "../lock/locker.h"
+
+//按大小分级的缓冲区池:最小一级2KB,每级翻倍,最大一级1MB
+//每级一条空闲链表,链表结点直接存放在空闲缓冲区的开头,各线程共享
+class buffer_pool {
+public:
+    //单例模式
+    static buffer_pool* get_instance();
+
+    //取出容量不小于size的缓冲区,实际容量写入cap;size超过最大一级时返回NULL
+    char* acquire(int size, int* cap);
+    //归还缓冲区,cap必须是acquire时得到的容量
+    void release(char* buf, int cap);
+
+    static const int MIN_SIZE = 2048;
+    static const int MAX_SIZE = 1 << 20;
+
+private:
+    buffer_pool();
+    ~buffer_pool();
+
+    static int size_class(int size);
+
+    static const int CLASS_NUM = 10;
+    static const int MAX_FREE_BYTES = 4 << 20;  //每级空闲链表最多保留的字节数,超出的直接释放
+
+    struct free_node {
+        free_node* next;
+    };
+
+    locker m_lock[CLASS_NUM];
+    free_node* m_free[CLASS_NUM];
+    int m_free_count[CLASS_NUM];
+};
+
+#endif
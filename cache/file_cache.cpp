@@ -0,0 +1,245 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "file_cache.h"
+#include "../timer/lst_timer.h"
+
+file_cache::file_cache() {
+}
+
+file_cache::~file_cache() {
+    for (std::unordered_map<std::string, entry*>::iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        put(it->second);
+    }
+}
+
+//使用局部静态变量懒汉模式创建文件缓存
+file_cache* file_cache::get_instance() {
+    static file_cache cache;
+    return &cache;
+}
+
+//打开并映射文件,给出访问权限判定,判定规则与原来do_request中的一致
+file_cache::entry* file_cache::load(const char* path, bool exists, const struct stat& st) {
+    entry* e = new entry;
+    e->ref = 1;
+    e->fd = -1;
+    e->address = NULL;
+    e->mapped = false;
+    e->st = st;
+    e->mime = mime_types::lookup(path);
+    e->key = NULL;
+    if (!exists) {
+        e->status = FILE_NOT_FOUND;
+        return e;
+    }
+    if (!(st.st_mode & S_IROTH)) {
+        e->status = FILE_FORBIDDEN;
+        return e;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        e->status = FILE_IS_DIR;
+        return e;
+    }
+    e->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (e->fd < 0) {
+        e->status = FILE_NOT_FOUND;
+        return e;
+    }
+    if (st.st_size > 0 && st.st_size <= COPY_MAX_SIZE) {
+        e->address = (char*)malloc(st.st_size);
+        off_t done = 0;
+        while (done < st.st_size) {
+            ssize_t n = pread(e->fd, e->address + done, st.st_size - done, done);
+            if (n <= 0) {
+                break;
+            }
+            done += n;
+        }
+        //读取期间文件被截短,按不存在处理,下次验证时重新加载
+        if (done < st.st_size) {
+            free(e->address);
+            e->address = NULL;
+            close(e->fd);
+            e->fd = -1;
+            e->status = FILE_NOT_FOUND;
+            return e;
+        }
+    } else if (st.st_size > 0) {
+        //大文件只保留文件描述符,epoll后端用sendfile发送,不占用地址空间
+        e->mapped = true;
+    }
+    e->status = FILE_OK;
+    set_validators(e);
+    return e;
+}
+
+//实体标签和Last-Modified在加载时生成一次,命中时直接使用
+//inode、大小和mtime(纳秒)任一变化都会得到不同的实体标签,压缩版本的大小不同,实体标签也不同
+void file_cache::set_validators(entry* e) {
+    snprintf(e->etag, sizeof(e->etag), "\"%llx-%llx-%llx\"", (unsigned long long)e->st.st_ino,
+             (unsigned long long)e->st.st_size,
+             (unsigned long long)e->st.st_mtim.tv_sec * 1000000000ULL + e->st.st_mtim.tv_nsec);
+    struct tm tm;
+    gmtime_r(&e->st.st_mtime, &tm);
+    strftime(e->last_modified, sizeof(e->last_modified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+//缓存的条目是否仍与磁盘上的文件一致
+bool file_cache::same(const entry* e, bool exists, const struct stat& st) {
+    //不存在的文件的stat信息全为0
+    if (!exists) {
+        return e->st.st_ino == 0;
+    }
+    return e->st.st_ino == st.st_ino && e->st.st_size == st.st_size && e->st.st_mode == st.st_mode
+           && e->st.st_mtim.tv_sec == st.st_mtim.tv_sec && e->st.st_mtim.tv_nsec == st.st_mtim.tv_nsec;
+}
+
+file_cache::entry* file_cache::acquire(const char* path) {
+    uint64_t now = current_ms();
+    std::string key(path);
+
+    m_lock.lock();
+    std::unordered_map<std::string, entry*>::iterator it = m_entries.find(key);
+    if (it != m_entries.end() && now - it->second->checked < (uint64_t)REVALIDATE_MS) {
+        entry* e = it->second;
+        ++e->ref;
+        touch(e);
+        m_lock.unlock();
+        return e;
+    }
+    m_lock.unlock();
+
+    //未命中或需要重新验证,文件系统调用都在锁外进行
+    struct stat st;
+    bool exists = stat(path, &st) == 0;
+    if (!exists) {
+        memset(&st, 0, sizeof(st));
+    }
+    m_lock.lock();
+    it = m_entries.find(key);
+    if (it != m_entries.end() && same(it->second, exists, st)) {
+        entry* e = it->second;
+        e->checked = now;
+        ++e->ref;
+        touch(e);
+        m_lock.unlock();
+        return e;
+    }
+    m_lock.unlock();
+
+    entry* e = load(path, exists, st);
+    e->checked = now;
+    m_lock.lock();
+    it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        lru_of(it->second).erase(it->second->lru);
+        put(it->second);
+        it->second = e;
+    } else {
+        it = m_entries.insert(std::make_pair(key, e)).first;
+    }
+    e->key = &it->first;
+    std::list<entry*>& lru = lru_of(e);
+    lru.push_front(e);
+    e->lru = lru.begin();
+    if (&lru == &m_lru && (int)lru.size() > MAX_ENTRIES) {
+        evict(lru, LOW_ENTRIES);
+    } else if (&lru == &m_missing && (int)lru.size() > MAX_MISSING) {
+        evict(lru, LOW_MISSING);
+    }
+    ++e->ref;
+    m_lock.unlock();
+    return e;
+}
+
+void file_cache::release(entry* e) {
+    if (!e) {
+        return;
+    }
+    m_lock.lock();
+    put(e);
+    m_lock.unlock();
+}
+
+file_cache::entry* file_cache::adopt(char* data, const struct stat& st) {
+    entry* e = new entry;
+    e->status = FILE_OK;
+    e->st = st;
+    e->fd = -1;
+    e->address = data;
+    e->mapped = false;
+    e->ref = 1;
+    e->checked = 0;
+    e->mime = NULL;
+    e->key = NULL;
+    set_validators(e);
+    return e;
+}
+
+void file_cache::retain(entry* e) {
+    m_lock.lock();
+    ++e->ref;
+    m_lock.unlock();
+}
+
+//映射在锁外建立,两个线程同时映射同一文件时后完成的一方撤销自己的映射
+char* file_cache::map(entry* e) {
+    m_lock.lock();
+    char* address = e->address;
+    m_lock.unlock();
+    if (address || !e->mapped) {
+        return address;
+    }
+    void* p = mmap(0, e->st.st_size, PROT_READ, MAP_PRIVATE, e->fd, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    m_lock.lock();
+    if (!e->address) {
+        e->address = (char*)p;
+        p = NULL;
+    }
+    address = e->address;
+    m_lock.unlock();
+    if (p) {
+        munmap(p, e->st.st_size);
+    }
+    return address;
+}
+
+void file_cache::put(entry* e) {
+    if (--e->ref > 0) {
+        return;
+    }
+    if (e->mapped) {
+        if (e->address) {
+            munmap(e->address, e->st.st_size);
+        }
+    } else {
+        free(e->address);
+    }
+    if (e->fd != -1) {
+        close(e->fd);
+    }
+    delete e;
+}
+
+void file_cache::touch(entry* e) {
+    std::list<entry*>& lru = lru_of(e);
+    lru.splice(lru.begin(), lru, e->lru);
+}
+
+//丢弃的条目只交出缓存持有的引用,仍有连接在用时由最后一个使用者归还后释放
+void file_cache::evict(std::list<entry*>& lru, size_t low) {
+    while (lru.size() > low) {
+        entry* e = lru.back();
+        lru.pop_back();
+        m_entries.erase(m_entries.find(*e->key));
+        put(e);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+
+#include "../lock/locker.h"
+#include "../http/mime_types.h"
+
+//文件缓存:按解析后的完整路径缓存文件描述符、整个文件的映射、stat信息、MIME类型和访问权限判定
+//命中且未到重新验证时间时不产生任何文件系统调用;不存在的文件同样缓存,避免反复stat
+//条目带引用计数,同一文件的并发应答共享一份映射,文件变化后旧条目在最后一个使用者归还时才释放
+//按LRU淘汰,超过上限时从最久未使用的条目开始丢弃到低水位;不存在的文件单独计数,大量不存在的路径不会挤掉热点文件
+class file_cache {
+public:
+    enum FILE_STATUS {
+        FILE_OK = 0,
+        FILE_NOT_FOUND,
+        FILE_FORBIDDEN,     //其他用户不可读
+        FILE_IS_DIR
+    };
+
+    struct entry {
+        FILE_STATUS status;
+        struct stat st;
+        int fd;             //供sendfile使用,按偏移读取,多个连接可以共用
+        char* address;      //文件内容:小文件是读入内存的副本,大文件是map建立的只读映射,映射之前和空文件为NULL
+        bool mapped;        //是否为大文件,内容不读入内存,需要地址时通过map映射,受m_lock保护的只有address
+        int ref;            //引用计数,缓存本身持有一个,受m_lock保护
+        uint64_t checked;   //上次验证的时间(毫秒)
+        char etag[64];          //由inode、大小和mtime生成的强实体标签,带引号
+        char last_modified[32]; //mtime的HTTP日期
+        const mime_types::type* mime;   //按路径的扩展名确定的类型,adopt的条目没有路径,为NULL
+        const std::string* key;         //在缓存中的键,adopt的条目不在缓存中,为NULL
+        std::list<entry*>::iterator lru;    //在所属LRU链表中的位置
+    };
+
+    //单例模式
+    static file_cache* get_instance();
+
+    //取得path对应的条目,引用计数加1,用完后必须release
+    entry* acquire(const char* path);
+    void release(entry* e);
+    //已持有的条目再取得一份引用,供应答缓存使用
+    void retain(entry* e);
+    //大文件的内容地址:第一次调用时建立映射,之后共用;sendfile发送时只用fd,不需要映射
+    //小文件直接返回副本,映射失败返回NULL
+    char* map(entry* e);
+    //把malloc得到的数据包装成不属于任何路径的条目,引用计数为1,归还方式与普通条目相同
+    //st.st_size为数据长度,没有文件描述符,只能通过address发送
+    static entry* adopt(char* data, const struct stat& st);
+
+private:
+    file_cache();
+    ~file_cache();
+
+    static entry* load(const char* path, bool exists, const struct stat& st);
+    static void set_validators(entry* e);
+    static bool same(const entry* e, bool exists, const struct stat& st);
+    void put(entry* e);     //引用计数减1,为0时释放,调用时持有m_lock
+    std::list<entry*>& lru_of(const entry* e) {
+        return e->status == FILE_NOT_FOUND ? m_missing : m_lru;
+    }
+    void touch(entry* e);   //移到所属LRU链表的表头,调用时持有m_lock
+    void evict(std::list<entry*>& lru, size_t low);   //丢弃链表尾部的条目直到剩下low个,调用时持有m_lock
+
+    static const int MAX_ENTRIES = 1024;
+    static const int LOW_ENTRIES = 896;     //超过MAX_ENTRIES时淘汰到这个数量,不必每次插入都淘汰
+    static const int MAX_MISSING = 256;     //不存在的文件的条目另外计数
+    static const int LOW_MISSING = 192;
+    //不超过该大小的文件读入内存保存副本,文件在缓存期间被截短或改写时仍发送完整的旧内容,不会因访问映射越界而SIGBUS
+    static const int COPY_MAX_SIZE = 65536;
+    static const int REVALIDATE_MS = 1000;  //超过该时间的条目下次命中时重新stat,mtime、大小或inode变化则重新加载
+
+    locker m_lock;
+    std::unordered_map<std::string, entry*> m_entries;
+    std::list<entry*> m_lru;        //存在的文件,表头为最近使用的条目
+    std::list<entry*> m_missing;    //不存在的文件
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include <string.h>
+#include "response_cache.h"
+#include "../timer/lst_timer.h"
+
+//先构造文件缓存,保证它在应答缓存之后析构
+response_cache::response_cache() : m_size(0), m_hits(0), m_lookups(0) {
+    file_cache::get_instance();
+}
+
+response_cache::~response_cache() {
+    while (!m_lru.empty()) {
+        remove(m_lru.back());
+    }
+}
+
+//使用局部静态变量懒汉模式创建应答缓存
+response_cache* response_cache::get_instance() {
+    static response_cache cache;
+    return &cache;
+}
+
+//请求行中不会出现换行符,用它分隔url和编码组合
+std::string response_cache::make_key(const char* url, int accept) {
+    std::string key(url);
+    key += '\n';
+    key += (char)('0' + accept);
+    return key;
+}
+
+bool response_cache::lookup(const char* url, int accept, bool linger, char* header, int* header_len,
+                            file_cache::entry** file) {
+    ++m_lookups;
+    uint64_t now = current_ms();
+
+    m_lock.lock();
+    std::unordered_map<std::string, entry*>::iterator it = m_entries.find(make_key(url, accept));
+    if (it == m_entries.end() || now - it->second->checked >= (uint64_t)REVALIDATE_MS) {
+        m_lock.unlock();
+        return false;
+    }
+    entry* e = it->second;
+    m_lru.splice(m_lru.begin(), m_lru, e->lru);
+    int i = linger ? 1 : 0;
+    memcpy(header, e->header[i], e->header_len[i]);
+    *header_len = e->header_len[i];
+    file_cache::get_instance()->retain(e->file);
+    *file = e->file;
+    m_lock.unlock();
+
+    ++m_hits;
+    return true;
+}
+
+void response_cache::insert(const char* url, int accept, file_cache::entry* file, const char* header[2],
+                            const int header_len[2]) {
+    if (header_len[0] > HEADER_SIZE || header_len[1] > HEADER_SIZE) {
+        return;
+    }
+    std::string key = make_key(url, accept);
+    size_t size = key.size() + header_len[0] + header_len[1] + file->st.st_size;
+    if (size > MAX_BYTES / 8) {
+        return;
+    }
+    entry* e = new entry;
+    e->key = key;
+    e->file = file;
+    for (int i = 0; i < 2; ++i) {
+        memcpy(e->header[i], header[i], header_len[i]);
+        e->header_len[i] = header_len[i];
+    }
+    e->size = size;
+    e->checked = current_ms();
+    file_cache::get_instance()->retain(file);
+
+    m_lock.lock();
+    //文件变化后do_request取得的是新的文件条目,直接替换旧的应答
+    std::unordered_map<std::string, entry*>::iterator it = m_entries.find(e->key);
+    if (it != m_entries.end()) {
+        remove(it->second);
+    }
+    while (!m_lru.empty() && m_size + size > MAX_BYTES) {
+        remove(m_lru.back());
+    }
+    m_lru.push_front(e);
+    e->lru = m_lru.begin();
+    m_entries[e->key] = e;
+    m_size += size;
+    m_lock.unlock();
+}
+
+//正在发送该应答的连接各自持有文件条目的引用,这里只归还缓存持有的一份
+void response_cache::remove(entry* e) {
+    m_entries.erase(e->key);
+    m_lru.erase(e->lru);
+    m_size -= e->size;
+    file_cache::get_instance()->release(e->file);
+    delete e;
+}
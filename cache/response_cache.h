@@ -0,0 +1,63 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+
+#include "../lock/locker.h"
+#include "file_cache.h"
+
+//应答缓存:按请求的url缓存热点小文件的完整应答,即预先生成的状态行和头部,加上文件缓存中的文件内容
+//头部按保持连接和关闭连接各生成一份,命中时直接拷贝头部并指向缓存的文件内容,不需要do_request和vsnprintf
+//按LRU淘汰,缓存的总字节数不超过MAX_BYTES
+class response_cache {
+public:
+    static const int HEADER_SIZE = 320;         //预先生成的应答头的最大长度
+    static const int REPORT_INTERVAL = 100000;  //每查找这么多次在日志中记录一次命中率
+
+    //单例模式
+    static response_cache* get_instance();
+
+    //命中时把对应连接状态的应答头拷入header,并取得文件条目的一份引用,用完后由调用者归还文件缓存
+    //条目超过REVALIDATE_MS未经过do_request验证时按未命中处理
+    //accept为客户端可接受的压缩编码组合,不同组合协商出的应答可能不同,分别缓存
+    bool lookup(const char* url, int accept, bool linger, char* header, int* header_len, file_cache::entry** file);
+    //缓存do_request生成的应答,header[0]为关闭连接的应答头,header[1]为保持连接的应答头
+    void insert(const char* url, int accept, file_cache::entry* file, const char* header[2], const int header_len[2]);
+
+    uint64_t hits() { return m_hits.load(); }
+    uint64_t lookups() { return m_lookups.load(); }
+
+private:
+    struct entry {
+        std::string key;            //url和可接受的编码组合
+        file_cache::entry* file;    //应答正文,持有文件缓存条目的一份引用
+        char header[2][HEADER_SIZE];
+        int header_len[2];
+        size_t size;                //计入缓存总量的字节数
+        uint64_t checked;           //上次由do_request生成或验证的时间(毫秒)
+        std::list<entry*>::iterator lru;
+    };
+
+    response_cache();
+    ~response_cache();
+
+    static std::string make_key(const char* url, int accept);
+    void remove(entry* e);      //从缓存中删除并释放,调用时持有m_lock
+
+    static const size_t MAX_BYTES = 32 << 20;
+    static const int REVALIDATE_MS = 1000;     //与文件缓存的重新验证间隔相同
+
+    locker m_lock;
+    std::unordered_map<std::string, entry*> m_entries;
+    std::list<entry*> m_lru;    //表头为最近使用的条目
+    size_t m_size;
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_lookups;
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <zlib.h>
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+#include "variant_cache.h"
+
+//先构造文件缓存,保证它在压缩版本缓存之后析构
+variant_cache::variant_cache() : m_size(0), m_stop(false) {
+    file_cache::get_instance();
+    if (pthread_create(&m_thread, NULL, worker, this) != 0) {
+        throw std::exception();
+    }
+}
+
+variant_cache::~variant_cache() {
+    m_lock.lock();
+    m_stop = true;
+    m_lock.unlock();
+    m_jobstat.post();
+    pthread_join(m_thread, NULL);
+    while (!m_lru.empty()) {
+        remove(m_lru.back());
+    }
+}
+
+//使用局部静态变量懒汉模式创建压缩版本缓存
+variant_cache* variant_cache::get_instance() {
+    static variant_cache cache;
+    return &cache;
+}
+
+const char* variant_cache::name(int encoding) {
+    return encoding == BROTLI ? "br" : "gzip";
+}
+
+const char* variant_cache::suffix(int encoding) {
+    return encoding == BROTLI ? ".br" : ".gz";
+}
+
+bool variant_cache::compressible(const char* path) {
+    static const char* exts[] = {".html", ".htm", ".css", ".js", ".json", ".txt", ".xml", ".svg"};
+    const char* ext = strrchr(path, '.');
+    if (!ext || strchr(ext, '/')) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(exts) / sizeof(exts[0]); ++i) {
+        if (strcasecmp(ext, exts[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//源文件的inode、大小或mtime变化后,缓存的压缩版本作废
+static bool same_source(const struct stat& a, const struct stat& b) {
+    return a.st_ino == b.st_ino && a.st_size == b.st_size && a.st_mtim.tv_sec == b.st_mtim.tv_sec
+           && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+file_cache::entry* variant_cache::acquire(const char* path, const file_cache::entry* file, int encoding,
+                                          bool* pending) {
+#ifndef HAVE_BROTLI
+    if (encoding == BROTLI) {
+        return NULL;
+    }
+#endif
+    if (file->st.st_size < MIN_SIZE || file->st.st_size > MAX_SOURCE_SIZE) {
+        return NULL;
+    }
+    std::string key(path);
+    key += suffix(encoding);
+
+    m_lock.lock();
+    std::unordered_map<std::string, entry*>::iterator it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        entry* e = it->second;
+        if (same_source(e->source, file->st)) {
+            m_lru.splice(m_lru.begin(), m_lru, e->lru);
+            file_cache::entry* data = e->data;
+            if (data) {
+                file_cache::get_instance()->retain(data);
+            }
+            m_lock.unlock();
+            return data;
+        }
+        remove(e);
+    }
+    //交给后台线程压缩,本次发送源文件;等待的任务过多时本次不提交
+    bool submit = false;
+    if (m_pending.count(key)) {
+        *pending = true;
+    } else if (!m_stop && (int)m_jobs.size() < MAX_PENDING) {
+        job j;
+        j.key = key;
+        j.path = path;
+        j.source = file->st;
+        j.encoding = encoding;
+        m_jobs.push_back(j);
+        m_pending.insert(key);
+        *pending = true;
+        submit = true;
+    }
+    m_lock.unlock();
+    if (submit) {
+        m_jobstat.post();
+    }
+    return NULL;
+}
+
+void* variant_cache::worker(void* arg) {
+    variant_cache* cache = (variant_cache*)arg;
+    cache->run();
+    return cache;
+}
+
+//后台线程:重新打开源文件读入内存,确认与提交任务时是同一版本后压缩
+void variant_cache::run() {
+    while (true) {
+        m_jobstat.wait();
+        m_lock.lock();
+        if (m_stop) {
+            m_lock.unlock();
+            break;
+        }
+        if (m_jobs.empty()) {
+            m_lock.unlock();
+            continue;
+        }
+        job j = m_jobs.front();
+        m_jobs.pop_front();
+        m_lock.unlock();
+
+        bool ok = false;
+        char* out = NULL;
+        size_t out_len = 0;
+        int fd = open(j.path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && same_source(st, j.source)) {
+            char* data = (char*)malloc(st.st_size);
+            off_t done = 0;
+            while (done < st.st_size) {
+                ssize_t n = pread(fd, data + done, st.st_size - done, done);
+                if (n <= 0) {
+                    break;
+                }
+                done += n;
+            }
+            if (done == st.st_size) {
+                out = compress(data, st.st_size, j.encoding, &out_len);
+                ok = true;
+            }
+            free(data);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+
+        m_lock.lock();
+        m_pending.erase(j.key);
+        //文件在压缩前已变化时不缓存,下次请求会按新的版本重新提交
+        if (ok) {
+            entry* e = new entry;
+            e->key = j.key;
+            e->source = j.source;
+            e->data = NULL;
+            e->size = j.key.size();
+            //压缩后没有变小的文件也缓存结果,避免反复压缩
+            if (out && out_len < (size_t)j.source.st_size) {
+                struct stat vst = j.source;
+                vst.st_size = out_len;
+                e->data = file_cache::adopt(out, vst);
+                e->size += out_len;
+                out = NULL;
+            }
+            std::unordered_map<std::string, entry*>::iterator it = m_entries.find(e->key);
+            if (it != m_entries.end()) {
+                remove(it->second);
+            }
+            while (!m_lru.empty() && m_size + e->size > MAX_BYTES) {
+                remove(m_lru.back());
+            }
+            m_lru.push_front(e);
+            e->lru = m_lru.begin();
+            m_entries[e->key] = e;
+            m_size += e->size;
+        }
+        m_lock.unlock();
+        free(out);
+    }
+}
+
+//压缩失败返回NULL
+char* variant_cache::compress(const char* data, size_t len, int encoding, size_t* out_len) {
+#ifdef HAVE_BROTLI
+    if (encoding == BROTLI) {
+        size_t bound = BrotliEncoderMaxCompressedSize(len);
+        char* out = (char*)malloc(bound);
+        *out_len = bound;
+        if (!BrotliEncoderCompress(9, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, len, (const uint8_t*)data,
+                                   out_len, (uint8_t*)out)) {
+            free(out);
+            return NULL;
+        }
+        return out;
+    }
+#endif
+    (void)encoding;
+    //windowBits加16生成gzip格式
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return NULL;
+    }
+    size_t bound = deflateBound(&zs, len);
+    char* out = (char*)malloc(bound);
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = len;
+    zs.next_out = (Bytef*)out;
+    zs.avail_out = bound;
+    int ret = deflate(&zs, Z_FINISH);
+    *out_len = zs.total_out;
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+//正在发送该压缩版本的连接各自持有引用,这里只归还缓存持有的一份
+void variant_cache::remove(entry* e) {
+    m_entries.erase(e->key);
+    m_lru.erase(e->lru);
+    m_size -= e->size;
+    if (e->data) {
+        file_cache::get_instance()->release(e->data);
+    }
+    delete e;
+}
@@ -0,0 +1,81 @@
+#ifndef VARIANT_CACHE_H
+#define VARIANT_CACHE_H
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include <string>
+#include <list>
+#include <set>
+#include <unordered_map>
+
+#include "../lock/locker.h"
+#include "file_cache.h"
+
+//压缩版本缓存:文本类静态文件的gzip/br压缩结果,按文件路径、编码和源文件的inode、大小、mtime缓存
+//请求路径上只查找,未命中时把压缩任务交给后台线程,本次先发送未压缩的文件,压缩从不在工作线程中进行
+//压缩结果包装成文件缓存的条目,与普通文件一样按引用计数共享和归还;按LRU淘汰,总量不超过MAX_BYTES
+class variant_cache {
+public:
+    enum ENCODING {
+        GZIP = 0,
+        BROTLI,
+        ENCODING_NUM
+    };
+
+    static const int MIN_SIZE = 256;            //小于该大小的文件压缩收益太小,不压缩
+    static const int MAX_SOURCE_SIZE = 1 << 20; //后台线程最多压缩这么大的文件
+
+    //单例模式
+    static variant_cache* get_instance();
+
+    //Content-Encoding中的编码名称和预压缩旁路文件的后缀
+    static const char* name(int encoding);
+    static const char* suffix(int encoding);
+    //按扩展名判断是否为值得压缩的文本文件
+    static bool compressible(const char* path);
+
+    //查找path的encoding压缩版本,file为已从文件缓存取得的源文件条目
+    //命中时返回的条目带一份引用,用完后归还文件缓存;未命中时提交后台压缩,把pending置为true并返回NULL
+    //不值得压缩的文件也返回NULL,pending不变
+    file_cache::entry* acquire(const char* path, const file_cache::entry* file, int encoding, bool* pending);
+
+private:
+    struct entry {
+        std::string key;
+        file_cache::entry* data;    //压缩结果,压缩后没有变小时为NULL,表示只发送源文件
+        struct stat source;         //压缩时源文件的stat信息,用来判断源文件是否变化
+        size_t size;
+        std::list<entry*>::iterator lru;
+    };
+
+    struct job {
+        std::string key;
+        std::string path;
+        struct stat source;
+        int encoding;
+    };
+
+    variant_cache();
+    ~variant_cache();
+
+    static void* worker(void* arg);
+    void run();
+    static char* compress(const char* data, size_t len, int encoding, size_t* out_len);
+    void remove(entry* e);      //从缓存中删除并释放,调用时持有m_lock
+
+    static const size_t MAX_BYTES = 16 << 20;
+    static const int MAX_PENDING = 256;     //等待压缩的任务上限,超出时本次不提交
+
+    locker m_lock;
+    std::unordered_map<std::string, entry*> m_entries;
+    std::list<entry*> m_lru;    //表头为最近使用的条目
+    size_t m_size;
+
+    std::list<job> m_jobs;
+    std::set<std::string> m_pending;    //已提交还未完成的任务,避免同一文件重复压缩
+    sem m_jobstat;
+    bool m_stop;
+    pthread_t m_thread;
+};
+
+#endif
@@ -7,7 +7,7 @@ Config::Config() {
     // 日志写入方式， 默认同步
     LOGWrite = 0;
 
-    //触发组合模式，默认Listenfd LT + Connfd LT
+    //触发组合模式，默认Listenfd LT + Connfd LT，4为io_uring后端
     TRIGMode = 0;
 
     //listenfd触发模式，默认LT
@@ -22,6 +22,9 @@ Config::Config() {
     //数据库连接池数量,默认8
     sql_num = 8;
 
+    //数据库连接池的最小连接数,默认2,不够用时按需增加到sql_num
+    sql_min_num = 2;
+
     //线程池内的线程数量,默认8
     thread_num = 8;
 
@@ -31,11 +34,20 @@ Config::Config() {
     //并发模型,默认是proactor
     actor_model = 0;
 
+    //子反应堆数量,默认0即主线程单反应堆,建议设为CPU核数
+    reactor_num = 0;
+
+    //Cache-Control规则,默认图片和视频缓存一天,样式表缓存一小时,其余文件每次验证
+    cache_control = ".jpg=86400,.png=86400,.ico=86400,.mp4=86400,.css=3600,*=0";
+
+    //注册的确认方式,默认进入后台写入队列即返回成功,1为等写入数据库后返回
+    register_ack = 0;
+
 }
 
 void Config::parse_arg(int argc, char* argv[]) {
     int opt;
-    const char* str =  "p:l:m:o:s:t:c:a:";
+    const char* str =  "p:l:m:o:s:n:t:c:a:r:e:w:";
     while ( (opt = getopt(argc, argv, str)) != -1) {  // 优先级：== > =  因此opt = getopt(argc, argv, str) 左右必需加()
         switch (opt) {
         case 'p': {
@@ -58,6 +70,10 @@ void Config::parse_arg(int argc, char* argv[]) {
             sql_num = atoi(optarg);
             break;
         }
+        case 'n': {
+            sql_min_num = atoi(optarg);
+            break;
+        }
         case 't': {
             thread_num = atoi(optarg);
             break;
@@ -70,6 +86,18 @@ void Config::parse_arg(int argc, char* argv[]) {
             actor_model = atoi(optarg);
             break;
         }
+        case 'r': {
+            reactor_num = atoi(optarg);
+            break;
+        }
+        case 'e': {
+            cache_control = optarg;
+            break;
+        }
+        case 'w': {
+            register_ack = atoi(optarg);
+            break;
+        }
         default:
             break;
         }
@@ -33,6 +33,9 @@ public:
     //数据库连接池数量
     int sql_num;
 
+    //数据库连接池的最小连接数
+    int sql_min_num;
+
     //线程池内的线程数量
     int thread_num;
 
@@ -42,6 +45,15 @@ public:
     //并发模型选择
     int actor_model;
 
+    //子反应堆数量
+    int reactor_num;
+
+    //静态文件的Cache-Control规则
+    string cache_control;
+
+    //注册的确认方式
+    int register_ack;
+
 
 };
 
@@ -0,0 +1,58 @@
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include "cache_control.h"
+
+//使用局部静态变量懒汉模式创建规则表
+cache_control* cache_control::get_instance() {
+    static cache_control instance;
+    return &instance;
+}
+
+bool cache_control::init(const std::string& rules) {
+    m_rules.clear();
+    bool ok = true;
+    size_t pos = 0;
+    while (pos < rules.size()) {
+        size_t end = rules.find(',', pos);
+        if (end == std::string::npos) {
+            end = rules.size();
+        }
+        std::string item = rules.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos || eq == 0 || eq + 1 == item.size()) {
+            ok = false;
+            continue;
+        }
+        rule r;
+        r.pattern = item.substr(0, eq);
+        char* tail;
+        long age = strtol(item.c_str() + eq + 1, &tail, 10);
+        if (*tail != '\0' || age < 0 || (r.pattern[0] != '/' && r.pattern[0] != '.' && r.pattern != "*")) {
+            ok = false;
+            continue;
+        }
+        r.max_age = (int)age;
+        m_rules.push_back(r);
+    }
+    return ok;
+}
+
+int cache_control::max_age(const char* path) const {
+    size_t len = strlen(path);
+    for (size_t i = 0; i < m_rules.size(); ++i) {
+        const std::string& p = m_rules[i].pattern;
+        if (p == "*") {
+            return m_rules[i].max_age;
+        }
+        if (p[0] == '/' && strncmp(path, p.c_str(), p.size()) == 0) {
+            return m_rules[i].max_age;
+        }
+        if (p[0] == '.' && len >= p.size() && strcasecmp(path + len - p.size(), p.c_str()) == 0) {
+            return m_rules[i].max_age;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,31 @@
+#ifndef CACHE_CONTROL_H
+#define CACHE_CONTROL_H
+
+#include <string>
+#include <vector>
+
+//Cache-Control规则:按请求文件的路径给出max-age,启动时由-e参数设置,之后只读
+//规则以逗号分隔,每条为"模式=秒数":模式以/开头时匹配路径前缀,以.开头时匹配扩展名,*匹配所有文件
+//按给出的顺序取第一条匹配的规则;秒数为0时发送no-cache,要求每次都验证
+class cache_control {
+public:
+    //单例模式
+    static cache_control* get_instance();
+
+    //解析规则,格式错误的条目被忽略,返回是否全部有效
+    bool init(const std::string& rules);
+    //path为网站根目录下的路径,没有匹配的规则时返回-1,不发送Cache-Control
+    int max_age(const char* path) const;
+
+private:
+    struct rule {
+        std::string pattern;
+        int max_age;
+    };
+
+    cache_control() {}
+
+    std::vector<rule> m_rules;
+};
+
+#endif
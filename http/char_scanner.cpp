@@ -0,0 +1,104 @@
+#include "char_scanner.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+typedef const char* (*find_func)(const char*, const char*, char, char);
+
+static const char* find_scalar(const char* p, const char* end, char a, char b) {
+    for (; p < end; ++p) {
+        if (*p == a || *p == b) {
+            return p;
+        }
+    }
+    return end;
+}
+
+#if defined(__x86_64__)
+//SSE2是x86-64的基本指令集,不需要检测;不足16字节的尾部逐字节查找,不越过end读取
+static const char* find_sse2(const char* p, const char* end, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_scalar(p, end, a, b);
+}
+
+//返回前清空ymm寄存器的高128位,否则之后的SSE指令要付出AVX状态切换的代价
+__attribute__((target("avx2")))
+static const char* find_avx2(const char* p, const char* end, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const char* found = 0;
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+        if (mask) {
+            found = p + __builtin_ctz(mask);
+            break;
+        }
+    }
+    _mm256_zeroupper();
+    return found ? found : find_sse2(p, end, a, b);
+}
+#endif
+
+static bool supports_avx2() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+//按名字取实现,CPU不支持的返回NULL
+static find_func lookup(const char* name) {
+#if defined(__x86_64__)
+    if (strcmp(name, "avx2") == 0) {
+        return supports_avx2() ? find_avx2 : 0;
+    }
+    if (strcmp(name, "sse2") == 0) {
+        return find_sse2;
+    }
+#endif
+    return strcmp(name, "scalar") == 0 ? find_scalar : 0;
+}
+
+static find_func select_find(const char** name) {
+#if defined(__x86_64__)
+    *name = supports_avx2() ? "avx2" : "sse2";
+#else
+    *name = "scalar";
+#endif
+    return lookup(*name);
+}
+
+static const char* g_name = "";
+static find_func g_find = select_find(&g_name);
+
+const char* char_scanner::find(const char* begin, const char* end, char a, char b) {
+    return g_find(begin, end, a, b);
+}
+
+const char* char_scanner::name() {
+    return g_name;
+}
+
+bool char_scanner::use(const char* name) {
+    find_func f = lookup(name);
+    if (!f) {
+        return false;
+    }
+    g_find = f;
+    g_name = name;
+    return true;
+}
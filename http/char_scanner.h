@@ -0,0 +1,16 @@
+#ifndef CHAR_SCANNER_H
+#define CHAR_SCANNER_H
+
+//在请求报文中查找分隔字符(CR、LF、空格、冒号等)
+//x86-64上启动时按CPU支持选择AVX2(每次比较32字节)或SSE2(每次16字节)的实现,其他平台逐字节查找
+class char_scanner {
+public:
+    //返回[begin, end)中第一个等于a或b的字符的位置,没有时返回end
+    static const char* find(const char* begin, const char* end, char a, char b);
+    //当前使用的实现,写入日志
+    static const char* name();
+    //换成指定的实现("avx2"、"sse2"或"scalar"),CPU不支持或没有该实现时返回false;供测试比较各个实现
+    static bool use(const char* name);
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "chunked_decoder.h"
+
+void chunked_decoder::init() {
+    m_state = SIZE;
+    m_size = 0;
+    m_digits = false;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+//chunk = chunk-size [ chunk-ext ] CRLF chunk-data CRLF
+//最后一个块的大小为0,之后是若干行trailer和一个空行
+int chunked_decoder::decode(const char* data, int len, const char** piece, int* piece_len) {
+    *piece = 0;
+    *piece_len = 0;
+    int i = 0;
+    while (i < len && m_state != DONE && m_state != BAD) {
+        char c = data[i];
+        switch (m_state) {
+            case SIZE: {
+                int v = hex_value(c);
+                if (v >= 0) {
+                    if (m_size > (MAX_CHUNK_SIZE >> 4)) {
+                        m_state = BAD;
+                        break;
+                    }
+                    m_size = m_size * 16 + v;
+                    m_digits = true;
+                } else if (m_digits && (c == ';' || c == ' ' || c == '\t')) {
+                    m_state = EXTENSION;
+                } else if (m_digits && c == '\r') {
+                    m_state = SIZE_LF;
+                } else {
+                    m_state = BAD;
+                    break;
+                }
+                ++i;
+                break;
+            }
+            case EXTENSION: {
+                if (c == '\r') {
+                    m_state = SIZE_LF;
+                }
+                ++i;
+                break;
+            }
+            case SIZE_LF: {
+                if (c != '\n') {
+                    m_state = BAD;
+                    break;
+                }
+                m_state = (m_size == 0) ? TRAILER_START : DATA;
+                ++i;
+                break;
+            }
+            case DATA: {
+                long n = len - i;
+                if (n > m_size) {
+                    n = m_size;
+                }
+                *piece = data + i;
+                *piece_len = n;
+                m_size -= n;
+                i += n;
+                if (m_size == 0) {
+                    m_state = DATA_CR;
+                }
+                return i;
+            }
+            case DATA_CR: {
+                m_state = (c == '\r') ? DATA_LF : BAD;
+                ++i;
+                break;
+            }
+            case DATA_LF: {
+                if (c != '\n') {
+                    m_state = BAD;
+                    break;
+                }
+                m_state = SIZE;
+                m_digits = false;
+                ++i;
+                break;
+            }
+            case TRAILER_START: {
+                m_state = (c == '\r') ? LAST_LF : TRAILER;
+                ++i;
+                break;
+            }
+            case TRAILER: {
+                if (c == '\r') {
+                    m_state = TRAILER_LF;
+                }
+                ++i;
+                break;
+            }
+            case TRAILER_LF: {
+                m_state = (c == '\n') ? TRAILER_START : BAD;
+                ++i;
+                break;
+            }
+            case LAST_LF: {
+                m_state = (c == '\n') ? DONE : BAD;
+                ++i;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return i;
+}
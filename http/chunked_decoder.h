@@ -0,0 +1,41 @@
+#ifndef CHUNKED_DECODER_H
+#define CHUNKED_DECODER_H
+
+//chunked传输编码的增量解码器:数据可以分任意多次到达,每次只处理已到达的部分
+//块大小行、块扩展和trailer只做语法检查后丢弃,块数据原样交给调用者,解码器自身不缓存任何数据
+class chunked_decoder {
+public:
+    static const long MAX_CHUNK_SIZE = 1L << 30;    //单个块的最大长度,超过时按格式错误处理
+
+    chunked_decoder() { init(); }
+
+    void init();
+    //从data开始解析最多len个字节,返回消耗的字节数
+    //遇到块数据时解析到该段块数据的末尾就返回,*piece指向data中的块数据,*piece_len为其长度;否则*piece_len为0
+    //解析到最后一个块和trailer之后的空行时停止,之后的数据不消耗
+    int decode(const char* data, int len, const char** piece, int* piece_len);
+    bool done() const { return m_state == DONE; }
+    bool bad() const { return m_state == BAD; }
+
+private:
+    enum STATE {
+        SIZE = 0,       //块大小的十六进制数字
+        EXTENSION,      //块扩展,跳过
+        SIZE_LF,
+        DATA,
+        DATA_CR,        //块数据之后的CRLF
+        DATA_LF,
+        TRAILER_START,  //最后一个块之后的一行的开头,空行表示结束
+        TRAILER,        //trailer中的一行,跳过
+        TRAILER_LF,
+        LAST_LF,
+        DONE,
+        BAD
+    };
+
+    int m_state;
+    long m_size;        //块大小,读到块数据后为本块剩余的字节数
+    bool m_digits;      //块大小至少有一位数字
+};
+
+#endif
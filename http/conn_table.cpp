@@ -0,0 +1,87 @@
+#include <sys/resource.h>
+#include "conn_table.h"
+
+conn_table::conn_table() {
+    //连接对象析构时会向缓冲区池归还读缓冲区,先创建缓冲区池,使它晚于连接表析构
+    buffer_pool::get_instance();
+    m_slots = NULL;
+    m_size = 0;
+    m_free = NULL;
+    m_free_count = 0;
+}
+
+conn_table::~conn_table() {
+    for (int i = 0; i < m_size; ++i) {
+        delete m_slots[i];
+    }
+    delete[] m_slots;
+    while (m_free) {
+        conn_node* node = m_free;
+        m_free = node->next_free;
+        delete node;
+    }
+}
+
+//使用局部静态变量懒汉模式创建连接表
+conn_table* conn_table::get_instance() {
+    static conn_table table;
+    return &table;
+}
+
+void conn_table::init() {
+    struct rlimit limit;
+    rlim_t size = MAX_SIZE;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        //软限制低于硬限制时先提高,RLIM_INFINITY比任何值都大,因此最多提高到MAX_SIZE
+        rlim_t want = (limit.rlim_max < (rlim_t)MAX_SIZE) ? limit.rlim_max : (rlim_t)MAX_SIZE;
+        if (limit.rlim_cur < want) {
+            limit.rlim_cur = want;
+            if (setrlimit(RLIMIT_NOFILE, &limit) != 0) {
+                getrlimit(RLIMIT_NOFILE, &limit);
+            }
+        }
+        if (limit.rlim_cur < size) {
+            size = limit.rlim_cur;
+        }
+    }
+    m_size = (int)size;
+    m_slots = new conn_node*[m_size]();
+}
+
+http_conn* conn_table::alloc(int fd) {
+    if (m_slots[fd]) {
+        return &m_slots[fd]->conn;
+    }
+    conn_node* node = NULL;
+    m_lock.lock();
+    if (m_free) {
+        node = m_free;
+        m_free = node->next_free;
+        --m_free_count;
+    }
+    m_lock.unlock();
+    if (!node) {
+        node = new conn_node;
+    }
+    node->next_free = NULL;
+    m_slots[fd] = node;
+    return &node->conn;
+}
+
+void conn_table::free(int fd) {
+    conn_node* node = m_slots[fd];
+    if (!node) {
+        return;
+    }
+    m_slots[fd] = NULL;
+    node->conn.recycle();
+    m_lock.lock();
+    if (m_free_count < MAX_FREE) {
+        node->next_free = m_free;
+        m_free = node;
+        ++m_free_count;
+        node = NULL;
+    }
+    m_lock.unlock();
+    delete node;
+}
@@ -0,0 +1,58 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <stddef.h>
+
+#include "../lock/locker.h"
+#include "../timer/lst_timer.h"
+#include "http_conn.h"
+
+//连接表:按文件描述符索引,表本身只是一组指针,大小由RLIMIT_NOFILE决定
+//连接对象在accept时从空闲链表取出(没有时才new),关闭后归还,内存随活跃连接数而不是fd上限增长
+class conn_table {
+public:
+    //单例模式
+    static conn_table* get_instance();
+
+    //按RLIMIT_NOFILE确定表的大小,软限制低于硬限制时先提高到硬限制
+    void init();
+    int size() const {
+        return m_size;
+    }
+
+    //fd上的连接对象,该fd上没有连接时返回NULL
+    http_conn* get(int fd) {
+        return m_slots[fd] ? &m_slots[fd]->conn : NULL;
+    }
+    //fd上连接的定时器数据
+    client_data* get_data(int fd) {
+        return m_slots[fd] ? &m_slots[fd]->data : NULL;
+    }
+
+    //为新连接分配对象,fd上已有对象时直接复用
+    http_conn* alloc(int fd);
+    //连接关闭时归还对象,必须在close(fd)之前调用,关闭后该fd可能马上被新连接复用
+    void free(int fd);
+
+private:
+    conn_table();
+    ~conn_table();
+
+    struct conn_node {
+        http_conn conn;
+        client_data data;
+        conn_node* next_free;
+    };
+
+    static const int MAX_FREE = 1024;   //空闲链表最多保留的对象个数,超出的直接释放
+    static const int MAX_SIZE = 1 << 20;    //RLIMIT_NOFILE为无穷大时表的大小
+
+    conn_node** m_slots;
+    int m_size;
+
+    locker m_lock;          //保护空闲链表,各反应堆线程并发分配和归还
+    conn_node* m_free;
+    int m_free_count;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include <string.h>
+#include <strings.h>
+
+#include "header_index.h"
+#include "char_scanner.h"
+
+//已知请求头的名字,顺序与header_index::NAME一致
+static constexpr const char* KNOWN_NAMES[] = {
+    "Host",
+    "Connection",
+    "Content-Length",
+    "Content-Type",
+    "Transfer-Encoding",
+    "Expect",
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Range",
+    "If-Range",
+    "If-Match",
+    "If-None-Match",
+    "If-Modified-Since",
+    "If-Unmodified-Since",
+    "Cache-Control",
+    "Cookie",
+    "Authorization",
+    "User-Agent",
+    "Referer",
+    "Origin",
+    "Upgrade",
+};
+static_assert(sizeof(KNOWN_NAMES) / sizeof(KNOWN_NAMES[0]) == header_index::KNOWN_COUNT,
+              "KNOWN_NAMES must match header_index::NAME");
+
+static const int TABLE_SIZE = 64;   //哈希表的槽数,必须是2的幂且大于已知请求头的个数
+
+constexpr int name_length(const char* s) {
+    int len = 0;
+    while (s[len]) {
+        ++len;
+    }
+    return len;
+}
+
+//FNV-1a,字母先转成小写,使大小写不同的名字落在同一个槽
+constexpr unsigned name_hash(const char* s, int len, unsigned seed) {
+    unsigned h = seed;
+    for (int i = 0; i < len; ++i) {
+        h = (h ^ ((unsigned char)s[i] | 0x20)) * 16777619u;
+    }
+    return (h ^ (h >> 15)) & (TABLE_SIZE - 1);
+}
+
+struct hash_table {
+    unsigned seed;
+    signed char slots[TABLE_SIZE];  //槽中已知请求头的编号,-1表示空槽
+};
+
+//编译期依次尝试种子,直到所有已知请求头都落在不同的槽中,查找时只需计算一次哈希、比较一次名字
+constexpr hash_table build_table() {
+    for (unsigned seed = 2166136261u; seed != 2166136261u + 100000; ++seed) {
+        hash_table table = {seed, {}};
+        for (int i = 0; i < TABLE_SIZE; ++i) {
+            table.slots[i] = -1;
+        }
+        bool perfect = true;
+        for (int i = 0; i < header_index::KNOWN_COUNT && perfect; ++i) {
+            unsigned slot = name_hash(KNOWN_NAMES[i], name_length(KNOWN_NAMES[i]), seed);
+            if (table.slots[slot] != -1) {
+                perfect = false;
+            }
+            table.slots[slot] = i;
+        }
+        if (perfect) {
+            return table;
+        }
+    }
+    return hash_table{0, {}};
+}
+
+static constexpr hash_table TABLE = build_table();
+static_assert(TABLE.seed != 0, "no perfect hash seed for KNOWN_NAMES, enlarge TABLE_SIZE");
+
+int header_index::lookup(const char* name, int len) {
+    int id = TABLE.slots[name_hash(name, len, TABLE.seed)];
+    if (id == -1 || strncasecmp(name, KNOWN_NAMES[id], len) != 0 || KNOWN_NAMES[id][len] != '\0') {
+        return UNKNOWN;
+    }
+    return id;
+}
+
+void header_index::clear() {
+    m_count = 0;
+    memset(m_known, -1, sizeof(m_known));
+}
+
+int header_index::add(char* buf, int off, int len) {
+    if (m_count == MAX_HEADERS) {
+        return -1;
+    }
+    char* line = buf + off;
+    char* end = line + len;
+    //名字和冒号之间不允许有空白,以空白开头的折行也不接受
+    char* colon = (char*)char_scanner::find(line, end, ':', ' ');
+    if (colon == end || *colon != ':' || colon == line || colon - line > MAX_NAME_LENGTH
+        || memchr(line, '\t', colon - line)) {
+        return -1;
+    }
+    char* value = colon + 1;
+    while (value < end && (*value == ' ' || *value == '\t')) {
+        ++value;
+    }
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t')) {
+        --end;
+    }
+    *end = '\0';
+
+    field& f = m_fields[m_count];
+    f.name_off = off;
+    f.name_len = colon - line;
+    f.value_off = value - buf;
+    f.value_len = end - value;
+    f.name = lookup(line, f.name_len);
+    if (f.name != UNKNOWN && m_known[f.name] == -1) {
+        m_known[f.name] = m_count;
+    }
+    return m_count++;
+}
+
+const char* header_index::value(const char* buf, int name, int* len) const {
+    int i = m_known[name];
+    if (i == -1) {
+        return 0;
+    }
+    if (len) {
+        *len = m_fields[i].value_len;
+    }
+    return buf + m_fields[i].value_off;
+}
+
+const char* header_index::value(const char* buf, const char* name, int* len) const {
+    int name_len = strlen(name);
+    int id = lookup(name, name_len);
+    if (id != UNKNOWN) {
+        return value(buf, id, len);
+    }
+    for (int i = 0; i < m_count; ++i) {
+        const field& f = m_fields[i];
+        if (f.name == UNKNOWN && f.name_len == name_len && strncasecmp(buf + f.name_off, name, name_len) == 0) {
+            if (len) {
+                *len = f.value_len;
+            }
+            return buf + f.value_off;
+        }
+    }
+    return 0;
+}
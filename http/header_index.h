@@ -0,0 +1,72 @@
+#ifndef HEADER_INDEX_H
+#define HEADER_INDEX_H
+
+//请求头索引:记录每个请求头的名字和值在读缓冲区中的位置,不拷贝数据也不分配内存
+//记录的是偏移而不是指针,读缓冲区换成更大一级时不需要平移
+//已知的请求头名字由编译期生成的完美哈希表识别,不区分大小写,可以直接按编号取值;其他请求头按名字顺序查找
+class header_index {
+public:
+    enum NAME {     //已知的请求头,顺序与header_index.cpp中的名字表一致
+        HOST = 0,
+        CONNECTION,
+        CONTENT_LENGTH,
+        CONTENT_TYPE,
+        TRANSFER_ENCODING,
+        EXPECT,
+        ACCEPT,
+        ACCEPT_ENCODING,
+        ACCEPT_LANGUAGE,
+        RANGE,
+        IF_RANGE,
+        IF_MATCH,
+        IF_NONE_MATCH,
+        IF_MODIFIED_SINCE,
+        IF_UNMODIFIED_SINCE,
+        CACHE_CONTROL,
+        COOKIE,
+        AUTHORIZATION,
+        USER_AGENT,
+        REFERER,
+        ORIGIN,
+        UPGRADE,
+        KNOWN_COUNT
+    };
+    static const int UNKNOWN = -1;
+    static const int MAX_HEADERS = 64;     //一个请求最多的请求头数,超过时按格式错误处理
+    static const int MAX_NAME_LENGTH = 256;    //请求头名字的最大长度
+
+    struct field {
+        int name_off;       //名字在读缓冲区中的偏移
+        int value_off;      //值在读缓冲区中的偏移,值以'\0'结尾
+        int value_len;
+        short name_len;
+        short name;         //已知请求头的编号,其他为UNKNOWN
+    };
+
+    header_index() { clear(); }
+
+    void clear();
+    //buf + off处是parse_line切分出的一行请求头,长度为len
+    //去掉值首尾的空白后在值的末尾写入'\0',返回该请求头在索引中的位置;没有冒号、名字为空或含空白、请求头太多时返回-1
+    int add(char* buf, int off, int len);
+    int count() const {
+        return m_count;
+    }
+    const field& at(int i) const {
+        return m_fields[i];
+    }
+    //已知请求头的值,同名请求头出现多次时取第一个,没有时返回NULL;len不为NULL时写入值的长度
+    const char* value(const char* buf, int name, int* len = 0) const;
+    //按名字取值,不区分大小写
+    const char* value(const char* buf, const char* name, int* len = 0) const;
+
+    //名字对应的已知请求头编号,不是已知的请求头时返回UNKNOWN
+    static int lookup(const char* name, int len);
+
+private:
+    field m_fields[MAX_HEADERS];
+    int m_count;
+    signed char m_known[KNOWN_COUNT];   //已知请求头第一次出现的位置,-1表示没有
+};
+
+#endif
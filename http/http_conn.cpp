@@ -6,22 +6,31 @@
 
 // 定义http响应的状态信息
 const char *status_200_title = "OK";
+const char *status_206_title = "Partial Content";
+const char *status_304_title = "Not Modified";
 const char *status_400_title = "Bad Request";
 const char *status_400_form = "Your request  has a syntax error";
 const char *status_403_title = "Forbidden";
 const char *status_403_form = "Your request was rejected by the server";
 const char *status_404_title = "Not Found";
 const char *status_404_form = "The requested resource could not be found on the server";
+const char *status_416_title = "Range Not Satisfiable";
+const char *status_416_form = "The requested range is not satisfiable";
 const char *status_500_title = "Internal Server Error";
 const char *status_500_form = "The server encountered an error while executing the request";
 
-locker m_lock;
-map<string, string> users;
+static_assert(http_conn::PATCH + 1 == router::METHOD_NUM, "router::METHOD_NUM must match http_conn::METHOD");
 
 void http_conn::initmysql_result(connection_pool* connPool) {
+    int m_close_log = connPool->m_close_log;     //静态成员函数中供LOG_*宏使用
+
     //先从连接池中取一个连接
     MYSQL* mysql = NULL;
     connectionRAII mysqlcon(&mysql, connPool);
+    if (!mysql) {
+        LOG_ERROR("no mysql connection, user table is empty");
+        return;
+    }
 
     //在user表中检索username，passwd数据，浏览器端输入
     if (mysql_query(mysql, "SELECT username, passwd FROM user")) {
@@ -29,6 +38,9 @@ void http_conn::initmysql_result(connection_pool* connPool) {
     }
     //从表中检索完整的结果集
     MYSQL_RES* result = mysql_store_result(mysql);
+    if (!result) {
+        return;
+    }
 
     //返回结果集中的列数
     int num_fields = mysql_num_fields(result);
@@ -36,12 +48,74 @@ void http_conn::initmysql_result(connection_pool* connPool) {
     //返回所有字段结构的数组
     MYSQL_FIELD* fields = mysql_fetch_field(result);
 
-    //从结果集中获取下一行，将对应的用户名和密码，存入map中
+    //从结果集中获取下一行，将对应的用户名和密码，存入用户表中
+    user_store* users = user_store::get_instance();
     while (MYSQL_ROW row = mysql_fetch_row(result)) {
-        string temp1(row[0]);
-        string temp2(row[1]);
-        users[temp1] = temp2;
+        users->insert(row[0], row[1]);
+    }
+    mysql_free_result(result);
+    LOG_INFO("loaded %d users", (int)users->size());
+}
+
+//注册内置的路由:judge.html上的按钮提交到/0和/1,welcome.html上的提交到/5、/6、/7,登录和注册表单提交到/2CGISQL.cgi和/3CGISQL.cgi
+void http_conn::init_routes() {
+    router* r = router::get_instance();
+    int pages = (1 << GET) | (1 << POST);
+    r->add(pages, "/", "/judge.html");      //url为/时显示欢迎界面
+    r->add(pages, "/0", "/register.html");
+    r->add(pages, "/1", "/log.html");
+    r->add(pages, "/5", "/picture.html");
+    r->add(pages, "/6", "/video.html");
+    r->add(pages, "/7", "/fans.html");
+    r->add(1 << POST, "/2CGISQL.cgi", login);
+    r->add(1 << POST, "/3CGISQL.cgi", sign_up);
+}
+
+//将用户名和密码从"user=...&password=..."形式的消息体中提取出来,消息体可能很长,最多各取99个字符,只需要读取消息体的开头
+bool http_conn::read_user_form(char* name, char* password) {
+    if (m_body_size == 0) {
+        return false;
+    }
+    char form[256];
+    int i;
+    int string_len = read_body(form, sizeof(form));
+    for (i = 5; i < string_len && form[i] != '&' && i - 5 < 99; ++i) {
+        name[i - 5] = form[i];
+    }
+    name[i - 5] = '\0';
+    int j = 0;
+    for (i = i + 10; i < string_len && j < 99; ++i, ++j) {
+        password[j] = form[i];
+    }
+    password[j] = '\0';
+    return true;
+}
+
+//登录:若浏览器端输入的用户名和密码在表中可以查找到,进入欢迎界面,否则进入登录失败界面
+const char* http_conn::login(http_conn* conn) {
+    char name[100], password[100];
+    if (!conn->read_user_form(name, password)) {
+        return NULL;
+    }
+    return user_store::get_instance()->check(name, password) ? "/welcome.html" : "/logError.html";
+}
+
+//注册:用户名在用户表中不存在时插入,同名的并发注册只有一个成功,新用户交给后台写入数据库
+//写入失败(后台线程没有运行,或ACK_COMMITTED时最终写入失败)时从用户表中撤销,注册失败的用户不能登录
+const char* http_conn::sign_up(http_conn* conn) {
+    char name[100], password[100];
+    if (!conn->read_user_form(name, password)) {
+        return NULL;
+    }
+    user_store* users = user_store::get_instance();
+    if (!users->insert(name, password)) {
+        return "/registerError.html";
     }
+    if (!user_writer::get_instance()->submit(name, password)) {
+        users->erase(name);
+        return "/registerError.html";
+    }
+    return "/log.html";
 }
 
 //对文件描述符设置为非阻塞
@@ -87,8 +161,7 @@ void modfd(int epollfd, int fd, int ev, int TRIGmode) {
     epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
 }
 
-int http_conn::m_user_count = 0;
-int http_conn::m_epollfd = -1;
+atomic<int> http_conn::m_user_count(0);
 
 //关闭连接，关闭一个连接，客户总量减一
 void http_conn::close_conn(bool real_close) {
@@ -100,120 +173,272 @@ void http_conn::close_conn(bool real_close) {
     }
 }
 
+http_conn::~http_conn() {
+    release_read_buf();
+}
+
 //初始化连接,外部调用初始化套接字地址
-void http_conn::init(int sockfd, const sockaddr_in& addr, char* root, int TRIGMode,
-                     int close_log, string user, string passwd, string sqlname) {
+void http_conn::init(int sockfd, const sockaddr_in& addr, int epollfd, char* root, int TRIGMode,
+                     int close_log) {
     m_sockfd = sockfd;
     m_address = addr;
+    m_epollfd = epollfd;
+    m_TRIGMode = TRIGMode;
+    m_worker_io = false;
 
-    addfd(m_epollfd, sockfd, true, m_TRIGMode);
+    //io_uring后端不向epoll注册
+    if (m_epollfd != -1) {
+        addfd(m_epollfd, sockfd, true, m_TRIGMode);
+    }
     ++m_user_count;
 
     //当浏览器出现连接重置时，可能是网站根目录出错或http响应格式出错或者访问的文件中内容完全为空
     doc_root = root;
-    m_TRIGMode = TRIGMode;
     m_close_log = close_log;
 
-    strcpy(sql_user, user.c_str());    //c_str()函数用于string与const char* 之间的转换,
-    strcpy(sql_passwd, passwd.c_str());
-    strcpy(sql_name, sqlname.c_str());
-
     init();
 }
 
 
-//初始化新接受的连接,check_state默认为分析请求行状态
+//初始化新接受的连接或保持连接上的下一次读写,读缓冲区中保留流水线中后续请求已读入的部分
 void http_conn::init() {
-    mysql = NULL;
+    consume_read();
     bytes_to_send = 0;
     bytes_have_send = 0;
+    m_write_idx = 0;
+    m_write_begin = 0;
+    m_iv_count = 0;
+    m_iv_idx = 0;
+    m_state = 0;
+    timer_flag = 0;
 
+    init_request();
+}
+
+//初始化一个请求的解析状态,check_state默认为分析请求行状态
+void http_conn::init_request() {
     m_check_state = CHECK_STATE_REQUESTLINE;
     m_linger = false;
+    m_accept = 0;
+    m_encoding = -1;
+    m_vary = false;
+    m_variant_pending = false;
 
     m_method = GET;
     m_url = 0;
     m_version = 0;
     m_content_length = 0;
-    m_host = 0;
-    m_start_line = 0;
-    m_checked_idx = 0;
-    m_read_idx = 0;
-    m_write_idx = 0;
-
+    m_headers.clear();
+    m_max_age = -1;
+    m_mime = mime_types::html();
+    m_chunked = false;
+    m_chunk.init();
+    m_body_start = 0;
+    m_body_len = 0;
+    m_body_size = 0;
+    close_body();
     cgi = 0;
-    m_state = 0;
-    timer_flag = 0;
-    improv = 0;
 
-    memset(m_read_buf, '\0', READ_BUFFER_SIZE);   // '\0’代表空字符(转义字符)【输出为空】
-    memset(m_write_buf, '\0', WRITE_BUFFER_SIZE);
     memset(m_real_file, '\0', FILENAME_LEN);
+}
+
+//m_checked_idx之前是已处理完的请求,之后的数据移到缓冲区开头;没有剩余数据时把缓冲区归还缓冲区池
+void http_conn::consume_read() {
+    if (!m_read_buf || m_checked_idx >= m_read_idx) {
+        release_read_buf();
+        return;
+    }
+    m_read_idx -= m_checked_idx;
+    memmove(m_read_buf, m_read_buf + m_checked_idx, m_read_idx);
+    m_read_buf[m_read_idx] = '\0';
+    m_checked_idx = 0;
+    m_start_line = 0;
+}
 
+//只检查请求头是否已经完整,以及消息体是否已全部读入,不修改读缓冲区
+//Content-Length无效时也按完整处理,由process_read返回BAD_REQUEST
+bool http_conn::request_ready() {
+    if (!m_read_buf || m_checked_idx >= m_read_idx) {
+        return false;
+    }
+    const char* begin = m_read_buf + m_checked_idx;
+    const char* end = (const char*)memmem(begin, m_read_idx - m_checked_idx, "\r\n\r\n", 4);
+    if (!end) {
+        return false;
+    }
+    long content_length = 0;
+    bool chunked = false;
+    for (const char* p = begin; p < end;) {
+        const char* eol = (const char*)memmem(p, end - p, "\r\n", 2);
+        if (!eol) {
+            eol = end;
+        }
+        const char* colon = char_scanner::find(p, eol, ':', ':');
+        int name = colon < eol ? header_index::lookup(p, colon - p) : header_index::UNKNOWN;
+        if (name == header_index::CONTENT_LENGTH) {
+            content_length = atol(colon + 1);
+        } else if (name == header_index::TRANSFER_ENCODING) {
+            chunked = true;
+        }
+        p = eol + 2;
+    }
+    const char* body = end + 4;
+    int left = m_read_buf + m_read_idx - body;
+    //chunked消息体用临时的解码器扫描一遍,看最后一个块是否已经到达
+    if (chunked) {
+        chunked_decoder decoder;
+        const char* piece;
+        int piece_len;
+        while (left > 0 && !decoder.done() && !decoder.bad()) {
+            int n = decoder.decode(body, left, &piece, &piece_len);
+            body += n;
+            left -= n;
+        }
+        return decoder.done() || decoder.bad();
+    }
+    if (content_length < 0 || content_length > MAX_BODY_SIZE) {
+        content_length = 0;
+    }
+    return content_length <= left;
 }
 
 //从状态机负责读取报文的一行，主状态机负责对该行数据进行解析
 
 //从状态机，用于读取出一行内容,在HTTP报文中，每一行的数据由\r\n作为结束字符
 //返回值为行的读取状态，有LINE_OK,LINE_BAD,LINE_OPEN
+//用char_scanner一次比较16或32个字节,直接跳到下一个\r或\n;行不完整时m_checked_idx停在已读入数据的末尾,数据到达后从这里继续
 http_conn::LINE_STATUS http_conn::parse_line() {
-    char temp;
-    for (; m_checked_idx < m_read_idx; ++m_checked_idx) {
-        temp = m_read_buf[m_checked_idx];
-        if (temp == '\r') {
-            if ((m_checked_idx + 1) == m_read_idx) {
-                return LINE_OPEN;
-            } else if (m_read_buf[m_checked_idx + 1] == '\n') {
-                m_read_buf[m_checked_idx++] = '\0';
-                m_read_buf[m_checked_idx++] = '\0';
-                return LINE_OK;
-            }
-            return LINE_BAD;
-            
-        } else if (temp == '\n') {     //如果当前字符是\n，也有可能读取到完整行,一般是上次读取到\r就到buffer末尾了，没有接收完整，再次接收时会出现这种情况 
-            if (m_checked_idx > 1 && m_read_buf[m_checked_idx - 1] == '\r') {
-                m_read_buf[m_checked_idx - 1] = '\0';
-                m_read_buf[m_checked_idx++] = '\0';
-                return LINE_OK;
-            }
-            return LINE_BAD;
-        }  
+    if (m_checked_idx >= m_read_idx) {
+        return LINE_OPEN;
+    }
+    m_checked_idx = char_scanner::find(m_read_buf + m_checked_idx, m_read_buf + m_read_idx, '\r', '\n') - m_read_buf;
+    if (m_checked_idx == m_read_idx) {
+        return LINE_OPEN;
+    }
+    char temp = m_read_buf[m_checked_idx];
+    if (temp == '\r') {
+        if ((m_checked_idx + 1) == m_read_idx) {
+            return LINE_OPEN;
+        } else if (m_read_buf[m_checked_idx + 1] == '\n') {
+            m_read_buf[m_checked_idx++] = '\0';
+            m_read_buf[m_checked_idx++] = '\0';
+            return LINE_OK;
+        }
+        return LINE_BAD;
+    }
+    //如果当前字符是\n，也有可能读取到完整行,一般是上次读取到\r就到buffer末尾了，没有接收完整，再次接收时会出现这种情况
+    if (m_checked_idx > 1 && m_read_buf[m_checked_idx - 1] == '\r') {
+        m_read_buf[m_checked_idx - 1] = '\0';
+        m_read_buf[m_checked_idx++] = '\0';
+        return LINE_OK;
+    }
+    return LINE_BAD;
+}
+
+void http_conn::release_read_buf() {
+    buffer_pool::get_instance()->release(m_read_buf, m_read_size);
+    m_read_buf = NULL;
+    m_read_size = 0;
+    m_read_idx = 0;
+    m_checked_idx = 0;
+    m_start_line = 0;
+}
+
+//解析出的请求行指针指向读缓冲区,换缓冲区时随数据一起平移;请求头索引记录的是偏移,不需要平移
+static char* rebase(char* p, char* old_buf, char* new_buf) {
+    return p ? new_buf + (p - old_buf) : NULL;
+}
+
+//保证读缓冲区还能放下len个字节,另外保留一个字节在数据末尾写入'\0'
+bool http_conn::reserve_read(int len) {
+    int need = m_read_idx + len + 1;
+    if (m_read_buf && need <= m_read_size) {
+        return true;
+    }
+    if (need > MAX_READ_BUFFER_SIZE) {
+        return false;
+    }
+    int cap = 0;
+    char* buf = buffer_pool::get_instance()->acquire(need < READ_BUFFER_SIZE ? READ_BUFFER_SIZE : need, &cap);
+    if (!buf) {
+        return false;
+    }
+    if (m_read_buf) {
+        memcpy(buf, m_read_buf, m_read_idx);
+        m_url = rebase(m_url, m_read_buf, buf);
+        m_version = rebase(m_version, m_read_buf, buf);
+        buffer_pool::get_instance()->release(m_read_buf, m_read_size);
+    }
+    m_read_buf = buf;
+    m_read_size = cap;
+    return true;
+}
+
+bool http_conn::append_read(const char* data, int len) {
+    if (!reserve_read(len)) {
+        return false;
     }
-    return LINE_OPEN;
+    memcpy(m_read_buf + m_read_idx, data, len);
+    m_read_idx += len;
+    m_read_buf[m_read_idx] = '\0';
+    return true;
 }
 
 //循环读取客户数据，直到无数据可读或对方关闭连接
 //非阻塞ET工作模式下，需要一次性将数据读完
+//数据先读入读缓冲区剩余空间,放不下的部分读入栈上的临时缓冲区,再换成更大的读缓冲区拷入,一次readv即可读完
+//连接上没有读缓冲区时第一段为空,数据到达后才借出缓冲区
+//接收消息体时只读到读缓冲区满为止,由parse_content处理后腾出空间再读,读缓冲区不随消息体增长
+//ET模式下没有读到EAGAIN也没关系,重新注册EPOLLIN时socket上还有数据会立即再次触发
 bool http_conn::read_once() {
-    if (m_read_idx >= READ_BUFFER_SIZE) {
+    char extra[EXTRA_READ_SIZE];
+    struct iovec iov[2];
+    bool body = (m_check_state == CHECK_STATE_CONTENT);
+    if (body && !reserve_read(BODY_READ_SIZE)) {
         return false;
     }
-    int bytes_read = 0;
-
-    //LT读取数据
-    if (m_TRIGMode == 0) {
-        bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, READ_BUFFER_SIZE - m_read_idx, 0);
-        m_read_idx += bytes_read;
-
-        if (bytes_read <= 0) {
+    while (true) {
+        int space = m_read_buf ? m_read_size - m_read_idx - 1 : 0;
+        if (body && space == 0) {
+            break;
+        }
+        iov[0].iov_base = m_read_buf ? m_read_buf + m_read_idx : NULL;
+        iov[0].iov_len = space;
+        iov[1].iov_base = extra;
+        iov[1].iov_len = sizeof(extra);
+        int bytes_read = readv(m_sockfd, iov, body ? 1 : 2);
+        if (bytes_read == -1) {
+            //ET模式下读到EAGAIN表示数据已经读完
+            if (m_TRIGMode == 1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            return false;
+        } else if (bytes_read == 0) {
             return false;
         }
-        return true;
-    } else {        //ET读数据 
-        while (true) {
-            bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, READ_BUFFER_SIZE - m_read_idx, 0);
-            if (bytes_read == -1) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    break;
-                }
-                return false;
-            } else if (bytes_read == 0) {
+        if (bytes_read <= space) {
+            m_read_idx += bytes_read;
+        } else {
+            m_read_idx += space;
+            //请求超过MAX_READ_BUFFER_SIZE时关闭连接
+            if (!append_read(extra, bytes_read - space)) {
                 return false;
             }
-            m_read_idx += bytes_read;
         }
-        return true;
-    }             
+        //LT读取数据,每次就绪只读一次
+        if (m_TRIGMode == 0) {
+            break;
+        }
+    }
+    if (m_read_buf) {
+        m_read_buf[m_read_idx] = '\0';
+    }
+    return true;
+}
+
+//io_uring后端:recv已由内核完成,把provided buffer中的数据拷入读缓冲区
+bool http_conn::read_from(const char* data, int len) {
+    return append_read(data, len);
 }
 
 //解析http请求行，获得请求方法，目标url及http版本号
@@ -261,57 +486,200 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char* text) {
     if (!m_url || m_url[0] != '/') {
         return BAD_REQUEST;
     }
-    //当url为/时，显示欢迎界面
-    if (strlen(m_url) == 1) {
-        strcat(m_url, "judge.html");
-    }
     //请求行处理完毕，将主状态机转移处理请求头
     m_check_state = CHECK_STATE_HEADER;
     return NO_REQUEST;
 
 }
 
+//解析Accept-Encoding,返回可接受的编码组合;q=0表示不接受,*表示接受所有编码
+static int parse_accept_encoding(const char* text) {
+    int accept = 0;
+    while (*text) {
+        text += strspn(text, " \t,");
+        int len = strcspn(text, " \t;,");
+        const char* end = text + strcspn(text, ",");
+        const char* q = strstr(text, "q=");
+        bool refused = q && q < end && atof(q + 2) <= 0;
+        if (!refused) {
+            if (len == 4 && strncasecmp(text, "gzip", 4) == 0) {
+                accept |= 1 << variant_cache::GZIP;
+            } else if (len == 2 && strncasecmp(text, "br", 2) == 0) {
+                accept |= 1 << variant_cache::BROTLI;
+            } else if (len == 1 && text[0] == '*') {
+                accept |= (1 << variant_cache::ENCODING_NUM) - 1;
+            }
+        }
+        text = end;
+    }
+    return accept;
+}
+
 //解析http请求的一个头部信息
 http_conn::HTTP_CODE http_conn::parse_headers(char* text) {
     //判断是空行还是请求头
     if (text[0] == '\0') {
         //判断是GET还是POST请求,消息体（请求数据）非空，则消息体长度不为0
-        if (m_content_length != 0) {
+        if (m_content_length != 0 || m_chunked) {
+            //同时带Content-Length和chunked的请求无法确定消息体的边界,拒绝
+            if (m_content_length != 0 && m_chunked) {
+                return BAD_REQUEST;
+            }
             //POST需要跳转到消息体（请求数据）处理状态
             m_check_state = CHECK_STATE_CONTENT;
+            m_body_start = m_checked_idx;
             return NO_REQUEST;
         }
         return GET_REQUEST;
-    } else if (strncasecmp(text, "Connection:", 11) == 0) {
-        text += 11;
-        text += strspn(text, " \t");
-        if (strcasecmp(text, "keep-alive") == 0) {
-            m_linger = true;
-        }
-    } else if (strncasecmp(text, "Content-length:", 15) == 0) {
-        text += 15;
-        text += strspn(text, " \t");
-        m_content_length = atol(text);
-    } else if (strncasecmp(text, "Host:", 5) == 0) {
-        text += 5;
-        text += strspn(text, " \t");
-        m_host = text;
-    } 
-    //else {
-       // LOG_INFO("opp!unkown header: %s", text);    // 需在log.h 定义
-   // }
+    }
+    //请求头记入索引,按名字的编号处理影响解析和连接的几个,其余的由处理函数按需读取
+    int i = m_headers.add(m_read_buf, text - m_read_buf, strlen(text));
+    if (i == -1) {
+        return BAD_REQUEST;
+    }
+    const char* value = m_read_buf + m_headers.at(i).value_off;
+    switch (m_headers.at(i).name) {
+        case header_index::CONNECTION: {
+            if (strcasecmp(value, "keep-alive") == 0) {
+                m_linger = true;
+            }
+            break;
+        }
+        case header_index::CONTENT_LENGTH: {
+            long content_length = atol(value);
+            if (content_length < 0 || content_length > MAX_BODY_SIZE) {
+                return BAD_REQUEST;
+            }
+            m_content_length = content_length;
+            break;
+        }
+        case header_index::TRANSFER_ENCODING: {
+            //只支持chunked
+            if (strcasecmp(value, "chunked") != 0) {
+                return BAD_REQUEST;
+            }
+            m_chunked = true;
+            break;
+        }
+        case header_index::ACCEPT_ENCODING: {
+            m_accept = parse_accept_encoding(value);
+            break;
+        }
+        default:
+            break;
+    }
     return NO_REQUEST;
 }
 
-//判断http请求是否被完整读入,并没有真正解析消息体内容
-http_conn::HTTP_CODE http_conn::parse_content(char* text) {
-    //判断buffer中是否读取了消息体
-    if (m_read_idx >= (m_content_length + m_checked_idx)) {
-        text[m_content_length] = '\0';
-        m_string = text;        //POST请求中最后为输入的用户名和密码
-        return GET_REQUEST;
+//消息体边读边处理:Content-Length范围内的数据或chunked解码出的块数据依次交给body_piece
+//处理过的原始数据从读缓冲区中删除,后面还没有处理的数据接到留在读缓冲区中的消息体之后
+//消息体之后可能是流水线中下一个请求的数据,不写入'\0',处理函数通过read_body按长度读取
+http_conn::HTTP_CODE http_conn::parse_content() {
+    int pos = m_checked_idx;
+    bool done = false;
+    while (pos < m_read_idx && !done) {
+        const char* piece = m_read_buf + pos;
+        int piece_len = 0;
+        if (m_chunked) {
+            pos += m_chunk.decode(m_read_buf + pos, m_read_idx - pos, &piece, &piece_len);
+            if (m_chunk.bad()) {
+                return BAD_REQUEST;
+            }
+            done = m_chunk.done();
+        } else {
+            piece_len = m_read_idx - pos;
+            if (piece_len > m_content_length - m_body_size) {
+                piece_len = m_content_length - m_body_size;
+            }
+            pos += piece_len;
+            done = (m_body_size + piece_len == m_content_length);
+        }
+        if (m_body_size + piece_len > MAX_BODY_SIZE) {
+            return BAD_REQUEST;
+        }
+        if (piece_len > 0 && !body_piece(piece, piece_len)) {
+            return INTERNAL_ERROR;
+        }
+    }
+    int keep = m_body_start + m_body_len;
+    memmove(m_read_buf + keep, m_read_buf + pos, m_read_idx - pos);
+    m_read_idx = keep + (m_read_idx - pos);
+    m_read_buf[m_read_idx] = '\0';
+    m_checked_idx = keep;
+    m_start_line = keep;
+    return done ? GET_REQUEST : NO_REQUEST;
+}
+
+static bool write_all(int fd, const char* data, int len) {
+    while (len > 0) {
+        int n = ::write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+//匿名临时文件,关闭后自动删除;文件系统不支持O_TMPFILE时创建后立即unlink
+static int open_body_file() {
+    int fd = open(P_tmpdir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        char path[] = P_tmpdir "/webserver_body_XXXXXX";
+        fd = mkostemp(path, O_CLOEXEC);
+        if (fd != -1) {
+            unlink(path);
+        }
+    }
+    return fd;
+}
+
+//不超过BODY_MEMORY_SIZE的消息体在读缓冲区中紧接着头部存放,data总在它之后,可以直接前移
+//超过时把已有的部分和之后收到的数据都写入临时文件,读缓冲区只保留头部
+bool http_conn::body_piece(const char* data, int len) {
+    m_body_size += len;
+    if (m_body_fd == -1 && m_body_size <= BODY_MEMORY_SIZE) {
+        memmove(m_read_buf + m_body_start + m_body_len, data, len);
+        m_body_len += len;
+        return true;
+    }
+    if (m_body_fd == -1) {
+        m_body_fd = open_body_file();
+        if (m_body_fd == -1) {
+            LOG_ERROR("create body file failed, errno is:%d", errno);
+            return false;
+        }
+        if (!write_all(m_body_fd, m_read_buf + m_body_start, m_body_len)) {
+            return false;
+        }
+        m_body_len = 0;
+    }
+    return write_all(m_body_fd, data, len);
+}
+
+//把消息体开头的最多len个字节拷入buf,返回拷贝的字节数,处理函数不必关心消息体在读缓冲区中还是临时文件中
+int http_conn::read_body(char* buf, int len) {
+    if (len > m_body_size) {
+        len = m_body_size;
+    }
+    if (m_body_fd == -1) {
+        memcpy(buf, m_read_buf + m_body_start, len);
+        return len;
+    }
+    int n = pread(m_body_fd, buf, len, 0);
+    return n < 0 ? 0 : n;
+}
+
+//临时文件在打开时已经删除,关闭后占用的磁盘空间即被回收
+void http_conn::close_body() {
+    if (m_body_fd != -1) {
+        close(m_body_fd);
+        m_body_fd = -1;
     }
-    return NO_REQUEST;
 }
 
 //解析报文整体流程,将主从状态机进行封装，对报文的每一行进行循环处理。
@@ -340,18 +708,22 @@ http_conn::HTTP_CODE http_conn::process_read() {
                 ret = parse_headers(text);          //解析请求头
                 if (ret == BAD_REQUEST) {
                     return BAD_REQUEST;
-                } else if (ret == GET_REQUEST) {    //完整解析GET请求后，跳转到报文响应函数
+                } else if (ret == GET_REQUEST) {    //完整解析GET请求后，先查应答缓存,未命中再跳转到报文响应函数
+                    if (lookup_response()) {
+                        return CACHED_REQUEST;
+                    }
                     return do_request();
                 }
                 break;
             }
             case CHECK_STATE_CONTENT: {
-                ret = parse_content(text);          //解析消息体
+                ret = parse_content();              //解析消息体
                 if (ret == GET_REQUEST) {           //完整解析POST请求后，跳转到报文响应函数
                     return do_request();
                 }
-                line_status = LINE_OPEN;            //解析完消息体即完成报文解析，避免再次进入循环，更新line_status
-                break;
+                //消息体还没有收全,直接返回等待更多数据;消息体格式错误时返回错误
+                //不能回到循环条件,否则parse_line会把已收到的消息体当作请求行扫描,移动m_checked_idx
+                return ret;
             }
             default: {
                 return INTERNAL_ERROR;
@@ -363,173 +735,222 @@ http_conn::HTTP_CODE http_conn::process_read() {
 }
 
   //当得到一个完整，正确的HTTP请求时，就分析目标文件的属性。如果目标文件存在、对所有用户
-//可读，且不是目录，则使用mmap将其映射到内存地址m_file_address处，并告诉调用者获取文件成功
+//可读，且不是目录，则从文件缓存取得它的映射或文件描述符，并告诉调用者获取文件成功
 http_conn::HTTP_CODE http_conn::do_request() {
     //将初始化的m_real_file赋值为网站根目录
     strcpy(m_real_file, doc_root);
     int len = strlen(doc_root);
-    //找到m_url中/的末次 位置
-    const char* p = strrchr(m_url, '/');
-    //处理cgi,实现登录和注册校验
-    if (cgi == 1 && (*(p + 1) == '2' || *(p + 1) == '3')) {
-        //根据标志判断是登录检测还是注册检测
-        char flag = m_url[1];
-        char* m_url_real = (char*)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/");
-        strcat(m_url_real, m_url + 2);
-        strncpy(m_real_file + len, m_url_real, FILENAME_LEN - len - 1);
-        free(m_url_real);
-        //将用户名和密码提取出来
-        char name[100], password[100];
-        int i;
-        for (i = 5; m_string[i] != '&'; ++i) {
-            name[i - 5] = m_string[i];
-        }
-        name[i - 5] = '\0';
-        int j = 0;
-        for (i = i + 10; m_string[i] != '\0'; ++i, ++j) {
-            password[j] = m_string[i];
-        }
-        password[j] = '\0';
-
-        if (*(p + 1) == '3') {
-             //如果是注册，先检测数据库中是否有重名的
-            //没有重名的，进行增加数据
-            char* sql_insert = (char*)malloc(sizeof(char) * 200);
-            strcpy(sql_insert, "INSERT INTO user(username, passwd) VALUES(");
-            strcat(sql_insert, "'");
-            strcat(sql_insert, name);
-            strcat(sql_insert, "', '");
-            strcat(sql_insert, password);
-            strcat(sql_insert, "')");
-            if (users.find(name) == users.end()) {
-                m_lock.lock();
-                int res = mysql_query(mysql, sql_insert);   //成功返回0，错误非0
-                users.insert(pair<string, string>(name, password));
-                m_lock.unlock();
-                if (!res) {
-                    strcpy(m_url, "/log.html");
-                } else {
-                    strcpy(m_url, "/registerError.html");
-                }
-            } else {
-                strcpy(m_url, "/registerError.html");
-            }
-        //如果是登录，直接判断
-        //若浏览器端输入的用户名和密码在表中可以查找到，返回1，否则返回0    
-        } else if (*(p + 1) == '2') {
-            if (users.find(name) != users.end() && users[name] == password) {
-                strcpy(m_url, "/welcome.html");
-            } else {
-                strcpy(m_url, "/logError.html");
-            }
+    //按方法和路径查找路由:静态路由直接给出页面,动态路由由处理函数给出结果页面,处理函数的结果页面不缓存
+    //没有匹配的路由时直接将url与网站目录拼接,例如welcome界面请求服务器上的一个图片
+    const char* file = m_url;
+    const router::route* route = router::get_instance()->find(m_method, m_url);
+    if (route && route->func) {
+        cgi = 1;
+        file = route->func(this);
+        if (!file) {
+            return NO_RESOURCE;
         }
+    } else if (route) {
+        file = route->file;
     }
-    //如果请求资源为/0，表示跳转注册界面
-    if (*(p + 1) == '0') {
-        char* m_url_real = (char*)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/register.html");
-         //将网站目录和/register.html进行拼接，更新到m_real_file中
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
-        free(m_url_real);
-    } else if (*(p + 1) == '1') {
-        char* m_url_real = (char*)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/log.html");
-        //将网站目录和/log.html进行拼接，更新到m_real_file中
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
-        free(m_url_real);
-    } else if (*(p + 1) == '5') {
-        char* m_url_real = (char*)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/picture.html");
-        //将网站目录和/picture.html进行拼接，更新到m_real_file中
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
-        free(m_url_real);
-    } else if (*(p + 1) == '6') {
-        char* m_url_real = (char*)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/video.html");
-        //将网站目录和/video.html进行拼接，更新到m_real_file中
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
-        free(m_url_real);
-    } else if (*(p + 1) == '7') {
-        char* m_url_real = (char*)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/fans.html");
-        //将网站目录和/fans.html进行拼接，更新到m_real_file中
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
-        free(m_url_real);
-    } else {
-         //如果以上均不符合，即不是登录和注册，直接将url与网站目录拼接
-         //这里的情况是welcome界面，请求服务器上的一个图片
-        strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1);
-    }
-    //通过stat获取请求资源文件信息，成功则将信息更新到m_file_stat结构体
+    strncpy(m_real_file + len, file, FILENAME_LEN - len - 1);
+    //从文件缓存取得目标文件的信息,命中时不需要stat、open和mmap
     //失败返回NO_RESOURCE状态，表示资源不存在
-    if (stat(m_real_file, &m_file_stat) < 0) {
-        return NO_RESOURCE;
+    m_file = file_cache::get_instance()->acquire(m_real_file);
+    switch (m_file->status) {
+        case file_cache::FILE_NOT_FOUND: {
+            release_file();
+            return NO_RESOURCE;
+        }
+        //判断文件的权限，是否可读，不可读则返回FORBIDDEN_REQUEST状态
+        case file_cache::FILE_FORBIDDEN: {
+            release_file();
+            return FORBIDDEN_REQUEST;
+        }
+        //判断文件类型，如果是目录，则返回BAD_REQUEST，表示请求报文有误
+        case file_cache::FILE_IS_DIR: {
+            release_file();
+            return BAD_REQUEST;
+        }
+        default:
+            break;
     }
-    //判断文件的权限，是否可读，不可读则返回FORBIDDEN_REQUEST状态
-    if (!(m_file_stat.st_mode & S_IROTH)) {
-        return FORBIDDEN_REQUEST;
+    //类型取自原文件,换成压缩版本后不变
+    m_mime = m_file->mime;
+    //文本文件按客户端可接受的编码换成压缩版本,Range请求总是针对未压缩的文件
+    m_vary = variant_cache::compressible(m_real_file);
+    if (m_vary && m_accept && !header(header_index::RANGE)) {
+        negotiate_encoding();
     }
-    //判断文件类型，如果是目录，则返回BAD_REQUEST，表示请求报文有误
-    if (S_ISDIR(m_file_stat.st_mode)) {
-        return BAD_REQUEST;
+    m_file_stat = m_file->st;
+    //静态文件按规则发送Cache-Control,登录和注册的结果页面不发送
+    if (cgi == 0) {
+        m_max_age = cache_control::get_instance()->max_age(m_real_file + len);
+    }
+    //epoll后端的大文件用sendfile直接从页缓存发送,不建立映射;小文件和io_uring后端writev缓存中的副本或映射
+    //后台压缩的版本只在内存中,没有文件描述符
+    if (m_epollfd != -1 && m_file_stat.st_size >= SENDFILE_MIN_SIZE && m_file->fd != -1) {
+        m_file_fd = m_file->fd;
+    } else {
+        m_file_address = file_cache::get_instance()->map(m_file);
+        if (!m_file_address && m_file_stat.st_size != 0) {
+            release_file();
+            return INTERNAL_ERROR;
+        }
     }
-    //以只读方式获取文件描述符，通过mmap将该文件映射到内存中
-    int fd = open(m_real_file, O_RDONLY);
-    m_file_address = (char*)mmap(0, m_file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    //避免文件描述符的浪费和占用
-    close(fd);
     //表示请求文件存在，且可以访问
     return FILE_REQUEST;
 }
 
-//对内存映射区执行munmap操作
+//按br、gzip的优先顺序选择压缩版本:先找与源文件同时或更晚生成的预压缩旁路文件(.br/.gz),再找后台压缩好的版本
+//都没有时继续发送源文件,后台压缩完成后的请求才会用上压缩版本
+void http_conn::negotiate_encoding() {
+    static const int prefer[] = {variant_cache::BROTLI, variant_cache::GZIP};
+    char sidecar[FILENAME_LEN + 4];
+    for (int i = 0; i < variant_cache::ENCODING_NUM; ++i) {
+        int encoding = prefer[i];
+        if (!(m_accept & (1 << encoding))) {
+            continue;
+        }
+        snprintf(sidecar, sizeof(sidecar), "%s%s", m_real_file, variant_cache::suffix(encoding));
+        file_cache::entry* variant = file_cache::get_instance()->acquire(sidecar);
+        if (variant->status != file_cache::FILE_OK || variant->st.st_mtime < m_file->st.st_mtime) {
+            file_cache::get_instance()->release(variant);
+            variant = variant_cache::get_instance()->acquire(m_real_file, m_file, encoding, &m_variant_pending);
+        }
+        if (variant) {
+            file_cache::get_instance()->release(m_file);
+            m_file = variant;
+            m_encoding = encoding;
+            return;
+        }
+    }
+}
+
+//静态文件的GET请求按url查找应答缓存,命中时应答头直接拷入写缓冲区,文件内容取自缓存的文件条目
+bool http_conn::lookup_response() {
+    if (cgi == 1 || header(header_index::RANGE) || header(header_index::IF_NONE_MATCH)
+        || header(header_index::IF_MODIFIED_SINCE)) {
+        return false;
+    }
+    response_cache* cache = response_cache::get_instance();
+    int header_len = 0;
+    bool hit = cache->lookup(m_url, m_accept, m_linger, m_write_buf + m_write_idx, &header_len, &m_file);
+    if (hit) {
+        m_write_idx += header_len;
+    }
+    if (cache->lookups() % response_cache::REPORT_INTERVAL == 0) {
+        LOG_INFO("response cache hit rate %.1f%%", cache->hits() * 100.0 / cache->lookups());
+    }
+    return hit;
+}
+
+//只缓存内容已读入内存的小文件的200应答,条件请求和Range请求不缓存,大文件仍走sendfile或映射
+//写缓冲区中是本次连接状态的应答头,另一种连接状态的应答头在写缓冲区中临时生成一次,再恢复原来的内容
+void http_conn::cache_response() {
+    int len = m_write_idx - m_write_begin;
+    if (cgi == 1 || header(header_index::RANGE) || header(header_index::IF_NONE_MATCH)
+        || header(header_index::IF_MODIFIED_SINCE) || m_variant_pending || !m_file_address
+        || m_file->mapped || len > response_cache::HEADER_SIZE) {
+        return;
+    }
+    char current[response_cache::HEADER_SIZE];
+    memcpy(current, m_write_buf + m_write_begin, len);
+    m_linger = !m_linger;
+    m_write_idx = m_write_begin;
+    bool ok = add_status_line(200, status_200_title) && add_headers(m_file_stat.st_size, m_mime);
+    m_linger = !m_linger;
+    if (ok) {
+        const char* header[2];
+        int header_len[2];
+        int i = m_linger ? 1 : 0;
+        header[i] = current;
+        header_len[i] = len;
+        header[1 - i] = m_write_buf + m_write_begin;
+        header_len[1 - i] = m_write_idx - m_write_begin;
+        response_cache::get_instance()->insert(m_url, m_accept, m_file, header, header_len);
+    }
+    memcpy(m_write_buf + m_write_begin, current, len);
+    m_write_idx = m_write_begin + len;
+}
+
+//把目标文件的条目归还文件缓存,映射和文件描述符由缓存统一释放
+void http_conn::release_file() {
+    if (m_file) {
+        file_cache::get_instance()->release(m_file);
+        m_file = NULL;
+    }
+    m_file_address = 0;
+    m_file_fd = -1;
+}
+
+//本批应答全部发送完或连接出错时,归还当前和流水线中前面各应答的文件条目
 void http_conn::unmap() {
-    if (m_file_address) {
-        munmap(m_file_address, m_file_stat.st_size);
-        m_file_address = 0;
+    release_file();
+    for (int i = 0; i < m_held_count; ++i) {
+        file_cache::get_instance()->release(m_held[i]);
     }
+    m_held_count = 0;
+}
+
+void http_conn::recycle() {
+    release_read_buf();
+    unmap();
+    close_body();
 }
 
 //写HTTP响应
-bool http_conn::write() {
+//发送完后读缓冲区中已有下一个完整请求时不重新注册读事件,新的数据可能不会再到达,由调用者直接交给工作线程
+bool http_conn::write(bool* pending) {
     int temp = 0;
+    *pending = false;
     //若要发送的数据长度为0
     //表示响应报文为空，一般不会出现这种情况
     if (bytes_to_send == 0) {
-        modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);
         init();
+        *pending = request_ready();
+        if (!*pending) {
+            wait_event(EPOLLIN);
+        }
         return true;
     }
     while (1) {
-        //将响应报文的状态行、消息头、空行和响应正文发送给浏览器端
-        temp = writev(m_sockfd, m_iv, m_iv_count);   //集中写，以顺序iov[0]、iov[1]至iov[iovcnt-1]从各缓冲区中聚集输出数据到fd
-        if (temp < 0) {
-
-            if (errno == EAGAIN) {
-                modfd(m_epollfd, m_sockfd, EPOLLOUT, m_TRIGMode);  //重新注册写事件
-                return true;
+        struct iovec* iv = m_iv + m_iv_idx;
+        if (m_file_fd != -1 && !iv->iov_base) {
+            //sendfile发送文件中的一段
+            off_t offset = m_iv_off[m_iv_idx];
+            temp = sendfile(m_sockfd, m_file_fd, &offset, iv->iov_len);
+        } else if (m_file_fd != -1) {
+            //sendfile发送文件:文件段之前的内存段带MSG_MORE发送,内核把它和随后sendfile发出的文件内容合并成完整的报文段
+            int count = 0;
+            while (m_iv_idx + count < m_iv_count && iv[count].iov_base) {
+                ++count;
             }
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iv;
+            msg.msg_iovlen = count;
+            temp = sendmsg(m_sockfd, &msg, (m_iv_idx + count < m_iv_count) ? MSG_MORE : 0);
+        } else {
+            //将响应报文的状态行、消息头、空行和响应正文发送给浏览器端
+            temp = writev(m_sockfd, iv, m_iv_count - m_iv_idx);   //集中写，以顺序iov[0]、iov[1]至iov[iovcnt-1]从各缓冲区中聚集输出数据到fd
+        }
+        if (temp < 0 && errno == EAGAIN) {
+            wait_event(EPOLLOUT);  //重新注册写事件
+            return true;
+        }
+        //sendfile返回0说明文件在发送过程中被截短
+        if (temp <= 0) {
             unmap();
             return false;
         }
 
-        bytes_have_send += temp;
-        bytes_to_send -= temp;
-        //第一个iovec头部信息的数据已发送完，发送第二个iovec数据
-        if (bytes_have_send >= m_iv[0].iov_len) {
-            m_iv[0].iov_len = 0;        //不再继续发送第一个iovec头部信息
-            m_iv[1].iov_base = m_file_address + (bytes_have_send - m_write_idx);
-            m_iv[1].iov_len = bytes_to_send;
-        } else {        //继续发送第一个iovec头部信息的数据
-            m_iv[0].iov_base = m_write_buf + bytes_have_send;
-            m_iv[0].iov_len = m_iv[0].iov_len - bytes_have_send;
-        }
-        if (bytes_to_send <= 0) {
-            unmap();
-            modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);    //在epoll树上重置EPOLLONESHOT事件
-            if (m_linger) {
-                init();      //重新初始化HTTP对象
+        if (!advance_write(temp)) {
+            if (finish_write()) {
+                *pending = request_ready();
+                if (!*pending) {
+                    wait_event(EPOLLIN);    //在epoll树上重置EPOLLONESHOT事件
+                }
                 return true;
             } else {
                 return false;
@@ -538,6 +959,54 @@ bool http_conn::write() {
     }
 }
 
+//已发送bytes字节后跳过发送完的段并调整剩余的一段,epoll和io_uring两种写路径共用
+bool http_conn::advance_write(int bytes) {
+    bytes_have_send += bytes;
+    bytes_to_send -= bytes;
+    while (m_iv_idx < m_iv_count) {
+        struct iovec* iv = m_iv + m_iv_idx;
+        if ((size_t)bytes < iv->iov_len) {
+            if (iv->iov_base) {
+                iv->iov_base = (char*)iv->iov_base + bytes;
+            }
+            m_iv_off[m_iv_idx] += bytes;
+            iv->iov_len -= bytes;
+            break;
+        }
+        bytes -= iv->iov_len;
+        ++m_iv_idx;
+    }
+    return bytes_to_send > 0;
+}
+
+//追加一段待发送的数据:base为NULL时表示用sendfile发送目标文件从offset开始的len个字节
+void http_conn::add_iov(char* base, off_t offset, int len) {
+    m_iv[m_iv_count].iov_base = base;
+    m_iv[m_iv_count].iov_len = len;
+    m_iv_off[m_iv_count] = offset;
+    ++m_iv_count;
+    bytes_to_send += len;
+}
+
+void http_conn::add_write_iov() {
+    add_iov(m_write_buf + m_write_begin, 0, m_write_idx - m_write_begin);
+}
+
+//目标文件中的一段:内容在内存中时直接指向它,否则由sendfile发送
+void http_conn::add_file_iov(off_t offset, int len) {
+    add_iov(m_file_address ? m_file_address + offset : NULL, offset, len);
+}
+
+//本批应答发送完毕,保持连接时重新初始化HTTP对象
+bool http_conn::finish_write() {
+    unmap();
+    if (m_linger) {
+        init();
+        return true;
+    }
+    return false;
+}
+
 //往写缓冲区写入待发送的数据
 bool http_conn::add_response(const char* format, ...) {
     //如果写入内容超出m_write_buf大小则报错
@@ -565,8 +1034,10 @@ bool http_conn::add_status_line(int status, const char* title) {
 }
 
 //添加消息报头，具体的添加文本长度、连接状态和空行
-bool http_conn::add_headers(int content_len) {
-    return add_content_length(content_len) &&  add_linger() && add_blank_line();
+//type为消息体的类型,为NULL时不发送Content-Type,由调用者自行添加
+bool http_conn::add_headers(int content_len, const mime_types::type* type) {
+    return add_content_length(content_len) && add_content_type(type) && add_validators() && add_encoding()
+           && add_accept_ranges() && add_linger() && add_blank_line();
 }
 
 //添加Content-Length，表示响应报文的长度
@@ -574,9 +1045,47 @@ bool http_conn::add_content_length(int content_len) {
     return add_response("Content-Length:%d\r\n", content_len);
 }
 
+//添加压缩编码,可压缩的文件不论是否压缩都带Vary头,让缓存按Accept-Encoding分别保存
+bool http_conn::add_encoding() {
+    if (m_encoding != -1 && !add_response("Content-Encoding:%s\r\n", variant_cache::name(m_encoding))) {
+        return false;
+    }
+    return !m_vary || add_response("Vary:%s\r\n", "Accept-Encoding");
+}
+
+//静态文件的实体标签、修改时间和Cache-Control
+bool http_conn::add_validators() {
+    if (!m_file || cgi == 1) {
+        return true;
+    }
+    if (!add_response("ETag:%s\r\n", m_file->etag) || !add_response("Last-Modified:%s\r\n", m_file->last_modified)) {
+        return false;
+    }
+    if (m_max_age == 0) {
+        return add_response("Cache-Control:%s\r\n", "no-cache");
+    } else if (m_max_age > 0) {
+        return add_response("Cache-Control:max-age=%d\r\n", m_max_age);
+    }
+    return true;
+}
+
+//文件应答声明支持Range;压缩版本不支持,Range总是针对未压缩的文件
+bool http_conn::add_accept_ranges() {
+    return !m_file || m_encoding != -1 || add_response("Accept-Ranges:%s\r\n", "bytes");
+}
+
 //添加文本类型，这里是html
-bool http_conn::add_content_type() {
-    return add_response("Content-Type:%s\r\n", "text/html");
+//头部行在类型表中已经拼好,直接拷贝
+bool http_conn::add_content_type(const mime_types::type* type) {
+    if (!type) {
+        return true;
+    }
+    if (m_write_idx + type->header_len >= WRITE_BUFFER_SIZE) {
+        return false;
+    }
+    memcpy(m_write_buf + m_write_idx, type->header, type->header_len);
+    m_write_idx += type->header_len;
+    return true;
 }
 
 //添加连接状态，通知浏览器端是保持连接还是关闭
@@ -594,12 +1103,229 @@ bool http_conn::add_content(const char* content) {
     return add_response("%s", content);
 }
 
+//解析HTTP日期(RFC 1123格式),失败返回-1
+static time_t parse_http_date(const char* text) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(text, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end || *end != '\0') {
+        return -1;
+    }
+    return timegm(&tm);
+}
+
+//解析"bytes=first-last, first-, -suffix"形式的Range,按起始位置排序并合并重叠或相邻的段
+//语法错误、段数超过MAX_RANGES或If-Range与文件不符时返回0,忽略Range;没有一段落在文件内时返回-1
+int http_conn::parse_range(byte_range* ranges) {
+    //If-Range为实体标签时必须与文件的强实体标签相同,为日期时必须与文件的修改时间一致
+    const char* if_range = header(header_index::IF_RANGE);
+    if (if_range) {
+        bool match = (if_range[0] == '"') ? strcmp(if_range, m_file->etag) == 0
+                                          : parse_http_date(if_range) == m_file_stat.st_mtime;
+        if (!match) {
+            return 0;
+        }
+    }
+    const char* range = header(header_index::RANGE);
+    if (strncasecmp(range, "bytes=", 6) != 0) {
+        return 0;
+    }
+    off_t size = m_file_stat.st_size;
+    int n = 0;
+    bool any = false;
+    const char* p = range + 6;
+    while (*p) {
+        p += strspn(p, " \t");
+        char* end;
+        off_t first, last;
+        if (*p == '-') {
+            //最后suffix个字节
+            off_t suffix = strtoll(p + 1, &end, 10);
+            if (end == p + 1 || suffix < 0) {
+                return 0;
+            }
+            first = suffix >= size ? 0 : size - suffix;
+            last = suffix == 0 ? -1 : size - 1;
+        } else {
+            first = strtoll(p, &end, 10);
+            if (end == p || first < 0 || *end != '-') {
+                return 0;
+            }
+            p = end + 1;
+            last = strtoll(p, &end, 10);
+            if (end == p) {
+                last = size - 1;
+            } else if (last < first) {
+                return 0;
+            } else if (last >= size) {
+                last = size - 1;
+            }
+        }
+        end += strspn(end, " \t");
+        if (*end != ',' && *end != '\0') {
+            return 0;
+        }
+        p = *end ? end + 1 : end;
+        any = true;
+        //起始位置超出文件的段不可满足,跳过
+        if (first >= size || last < first) {
+            continue;
+        }
+        if (n == MAX_RANGES) {
+            return 0;
+        }
+        ranges[n].first = first;
+        ranges[n].last = last;
+        ++n;
+    }
+    if (!any) {
+        return 0;
+    }
+    if (n == 0) {
+        return -1;
+    }
+    //插入排序后合并
+    for (int i = 1; i < n; ++i) {
+        byte_range r = ranges[i];
+        int j = i - 1;
+        for (; j >= 0 && ranges[j].first > r.first; --j) {
+            ranges[j + 1] = ranges[j];
+        }
+        ranges[j + 1] = r;
+    }
+    int m = 0;
+    for (int i = 1; i < n; ++i) {
+        if (ranges[i].first <= ranges[m].last + 1) {
+            if (ranges[i].last > ranges[m].last) {
+                ranges[m].last = ranges[i].last;
+            }
+        } else {
+            ranges[++m] = ranges[i];
+        }
+    }
+    return m + 1;
+}
+
+//206应答:一段时直接发送该段并带Content-Range;多段时按multipart/byteranges发送,
+//各段的头部和结束分隔符先生成在写缓冲区的应答头之后,文件内容仍按映射或sendfile发送
+bool http_conn::add_partial(const byte_range* ranges, int n) {
+    long long size = m_file_stat.st_size;
+    if (n == 1) {
+        long long first = ranges[0].first, last = ranges[0].last;
+        if (!add_status_line(206, status_206_title)
+            || !add_response("Content-Range:bytes %lld-%lld/%lld\r\n", first, last, size)
+            || !add_headers(last - first + 1, m_mime)) {
+            return false;
+        }
+        add_write_iov();
+        add_file_iov(first, last - first + 1);
+        return true;
+    }
+    //分隔符取当前时间和计数器,不会与文件内容巧合
+    static atomic<unsigned> counter(0);
+    char boundary[40];
+    snprintf(boundary, sizeof(boundary), "%08llx%08x", (unsigned long long)current_ms(), (unsigned)++counter);
+    //先在栈上生成各段的头部和结束分隔符,算出消息体总长度
+    char parts[RESPONSE_HEADER_SIZE];
+    int part_len[MAX_RANGES];
+    int used = 0;
+    long long total = 0;
+    for (int i = 0; i < n; ++i) {
+        long long first = ranges[i].first, last = ranges[i].last;
+        part_len[i] = snprintf(parts + used, sizeof(parts) - used,
+                               "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n",
+                               boundary, m_mime->mime, first, last, size);
+        if (part_len[i] >= (int)sizeof(parts) - used) {
+            return false;
+        }
+        used += part_len[i];
+        total += part_len[i] + last - first + 1;
+    }
+    int tail_len = snprintf(parts + used, sizeof(parts) - used, "\r\n--%s--\r\n", boundary);
+    if (tail_len >= (int)sizeof(parts) - used) {
+        return false;
+    }
+    total += tail_len;
+    if (!add_status_line(206, status_206_title)
+        || !add_response("Content-Type:multipart/byteranges; boundary=%s\r\n", boundary)
+        || !add_headers(total, NULL)
+        || m_write_idx + used + tail_len > WRITE_BUFFER_SIZE) {
+        return false;
+    }
+    add_write_iov();
+    char* part = m_write_buf + m_write_idx;
+    memcpy(part, parts, used + tail_len);
+    m_write_idx += used + tail_len;
+    for (int i = 0; i < n; ++i) {
+        add_iov(part, 0, part_len[i]);
+        part += part_len[i];
+        add_file_iov(ranges[i].first, ranges[i].last - ranges[i].first + 1);
+    }
+    add_iov(part, 0, tail_len);
+    return true;
+}
+
+//416应答:说明文件的实际大小
+bool http_conn::add_unsatisfiable() {
+    if (!add_status_line(416, status_416_title)
+        || !add_response("Content-Range:bytes */%lld\r\n", (long long)m_file_stat.st_size)
+        || !add_headers(strlen(status_416_form), mime_types::html()) || !add_content(status_416_form)) {
+        return false;
+    }
+    add_write_iov();
+    return true;
+}
+
+//If-None-Match优先:其中任一实体标签与文件的实体标签弱比较相同(忽略W/前缀)或为*时,客户端缓存的版本有效
+//没有If-None-Match时,文件在If-Modified-Since之后没有修改则有效
+bool http_conn::not_modified() {
+    if (cgi == 1) {
+        return false;
+    }
+    const char* if_none_match = header(header_index::IF_NONE_MATCH);
+    const char* if_modified_since = header(header_index::IF_MODIFIED_SINCE);
+    if (if_none_match) {
+        const char* etag = m_file->etag;
+        size_t len = strlen(etag);
+        const char* p = if_none_match;
+        while (*p) {
+            p += strspn(p, " \t,");
+            if (*p == '*') {
+                return true;
+            }
+            if (strncmp(p, "W/", 2) == 0) {
+                p += 2;
+            }
+            if (strncmp(p, etag, len) == 0 && strchr(" \t,", p[len])) {
+                return true;
+            }
+            p += strcspn(p, ",");
+        }
+        return false;
+    }
+    if (if_modified_since) {
+        time_t since = parse_http_date(if_modified_since);
+        return since != -1 && m_file_stat.st_mtime <= since;
+    }
+    return false;
+}
+
+//304应答:没有消息体,带上与200应答相同的实体标签、修改时间、Cache-Control和Vary
+bool http_conn::add_not_modified() {
+    if (!add_status_line(304, status_304_title) || !add_validators() || !add_encoding() || !add_linger()
+        || !add_blank_line()) {
+        return false;
+    }
+    add_write_iov();
+    return true;
+}
+
 //根据服务器处理HTTP请求的结果，决定返回给客户端的内容
 bool http_conn::process_write(HTTP_CODE ret) {
     switch (ret) {
         case INTERNAL_ERROR: {
             add_status_line(500, status_500_title);
-            add_headers(strlen(status_500_form));
+            add_headers(strlen(status_500_form), mime_types::html());
             if (!add_content(status_500_form)) {
                 return false;
             }
@@ -607,7 +1333,7 @@ bool http_conn::process_write(HTTP_CODE ret) {
         }
         case BAD_REQUEST: {
             add_status_line(404, status_404_title);
-            add_headers(strlen(status_404_form));
+            add_headers(strlen(status_404_form), mime_types::html());
             if (!add_content(status_404_form)) {
                 return false;
             }
@@ -615,61 +1341,145 @@ bool http_conn::process_write(HTTP_CODE ret) {
         }
         case FORBIDDEN_REQUEST: {
             add_status_line(403, status_403_title);
-            add_headers(strlen(status_403_form));
+            add_headers(strlen(status_403_form), mime_types::html());
             if (!add_content(status_403_form)) {
                 return false;
             }
             break;
         }
+        case CACHED_REQUEST: {      //应答缓存命中,应答头已拷入写缓冲区,缓存的都是内容在内存中的非空文件
+            m_file_stat = m_file->st;
+            m_file_address = m_file->address;
+            add_write_iov();
+            add_file_iov(0, m_file_stat.st_size);
+            return true;
+        }
         case FILE_REQUEST: {        //文件存在，200
-            add_status_line(200, status_200_title);
+            //条件请求命中客户端缓存时只发送304
+            if (not_modified()) {
+                return add_not_modified();
+            }
             //如果请求的资源存在
             if (m_file_stat.st_size != 0) {
-                add_headers(m_file_stat.st_size);
+                //带Range的请求只发送请求的部分,Range无效时忽略它发送整个文件
+                if (header(header_index::RANGE)) {
+                    byte_range ranges[MAX_RANGES];
+                    int n = parse_range(ranges);
+                    if (n < 0) {
+                        return add_unsatisfiable();
+                    } else if (n > 0) {
+                        return add_partial(ranges, n);
+                    }
+                }
+                add_status_line(200, status_200_title);
+                add_headers(m_file_stat.st_size, m_mime);
                 //第一个iovec指针指向响应报文缓冲区，长度指向m_write_idx
-                m_iv[0].iov_base = m_write_buf;
-                m_iv[0].iov_len = m_write_idx;
-                //第二个iovec指针指向mmap返回的文件指针，长度指向文件大小
-                m_iv[1].iov_base = m_file_address;
-                m_iv[1].iov_len = m_file_stat.st_size;
-                m_iv_count = 2;
-                //发送的全部数据为响应报文头部信息和文件大小
-                bytes_to_send = m_write_idx + m_file_stat.st_size;
+                //第二个iovec指针指向缓存中的文件内容,sendfile发送时为NULL
+                add_write_iov();
+                add_file_iov(0, m_file_stat.st_size);
                 return true;
             } else {    //如果请求的资源大小为0，则返回空白html文件
+                add_status_line(200, status_200_title);
                 const char* ok_string = "<html><body></body></html>";
-                add_headers(strlen(ok_string));
+                add_headers(strlen(ok_string), mime_types::html());
                 if (!add_content(ok_string)) {
                     return false;
                 }
             }
+            break;
         }
         default: {
             return false;
         }
     }
     //除FILE_REQUEST状态外，其余状态只申请一个iovec，指向响应报文缓冲区
-    m_iv[0].iov_base = m_write_buf;
-    m_iv[0].iov_len = m_write_idx;
-    m_iv_count = 1;
-    bytes_to_send = m_write_idx;
+    add_write_iov();
     return true;
 
 }
 
 // 由线程池中的工作线程调用， 这是处理HTTP请求的入口函数
-void http_conn::process() {
+//返回false时连接需要关闭,由调用者设置timer_flag并投递一次完成项,交回所属反应堆线程关闭
+bool http_conn::process() {
     HTTP_CODE read_ret = process_read();
     //NO_REQUEST，表示请求不完整，需要继续接收请求数据
     if (read_ret == NO_REQUEST) {
-        modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);    //注册并监听读事件
-        return;
+        wait_event(EPOLLIN);    //注册并监听读事件
+        return true;
+    }
+    bool write_ret = respond(read_ret);
+    //流水线:读缓冲区中已有下一个完整请求时接着处理,应答追加在后面,整批用一次writev发送
+    //关闭连接的请求之后的数据不再处理;用sendfile发送的应答只能是一批中的最后一个
+    while (write_ret && m_linger && m_file_fd == -1 && batch_room() && request_ready()) {
+        next_request();
+        HTTP_CODE ret = process_read();
+        //request_ready已确认请求完整,解析仍要求更多数据说明请求格式错误(例如行尾只有\r或\n)
+        //按错误请求应答并丢弃剩余数据;交给respond按NO_REQUEST处理会让整批已经准备好的应答都发不出去
+        if (ret == NO_REQUEST) {
+            ret = BAD_REQUEST;
+        }
+        write_ret = respond(ret);
+    }
+    //读缓冲区中没有后续请求的数据时归还,否则保留到本批应答发送完
+    if (m_checked_idx >= m_read_idx) {
+        release_read_buf();
     }
-    bool write_ret = process_write(read_ret);
     if (!write_ret) {
-        close_conn();
+        return false;
+    }
+    wait_event(EPOLLOUT);       //注册并监听写事件
+    return true;
+}
+
+//m_checked_idx已在请求的结尾,流水线中的下一个请求从这里开始;出错的请求无法确定结尾,丢弃剩余的数据
+//应答缓存以请求中的url为键,m_url指向读缓冲区,需在归还读缓冲区之前放入缓存
+bool http_conn::respond(HTTP_CODE ret) {
+    //请求已处理完,消息体不再需要;不等到下一个请求或连接关闭,避免空闲的长连接一直占用临时文件
+    close_body();
+    if (ret == BAD_REQUEST || ret == INTERNAL_ERROR) {
+        m_checked_idx = m_read_idx;
+    }
+    bool write_ret = process_write(ret);
+    if (write_ret && ret == FILE_REQUEST) {
+        cache_response();
+    }
+    return write_ret;
+}
+
+//前一个请求的应答和文件条目保留到整批发送完,解析状态从前一个请求的结尾重新开始
+void http_conn::next_request() {
+    if (m_file) {
+        m_held[m_held_count++] = m_file;
+        m_file = NULL;
+    }
+    m_file_address = 0;
+    m_write_begin = m_write_idx;
+    m_start_line = m_checked_idx;
+    init_request();
+}
+
+//追加的应答最多占用MAX_IOV段和RESPONSE_HEADER_SIZE字节的写缓冲区
+bool http_conn::batch_room() {
+    return m_held_count < MAX_PIPELINE - 1 && m_iv_count + MAX_IOV <= IOV_SIZE
+           && m_write_idx + RESPONSE_HEADER_SIZE <= WRITE_BUFFER_SIZE;
+}
+
+//等待下一次读写:epoll后端重置EPOLLONESHOT事件,io_uring后端把连接交回所属反应堆,由它提交recv或writev
+//reactor模式下只记下要等待的事件:工作线程在投递完成项之前注册,反应堆会在回收完成项之前再次派发或关闭这个连接
+void http_conn::wait_event(int ev) {
+    if (m_epollfd != -1 && !m_worker_io) {
+        modfd(m_epollfd, m_sockfd, ev, m_TRIGMode);
+        return;
+    }
+    m_state = (ev == EPOLLOUT) ? 1 : 0;
+    if (m_epollfd == -1) {
+        m_cq->push(this);
     }
-    modfd(m_epollfd, m_sockfd, EPOLLOUT, m_TRIGMode);       //注册并监听写事件
+}
+
+//reactor模式下反应堆线程回收完成项时调用,注册工作线程记下的事件
+void http_conn::rearm() {
+    modfd(m_epollfd, m_sockfd, m_state ? EPOLLOUT : EPOLLIN, m_TRIGMode);
 }
 
 
@@ -20,10 +20,25 @@
 #include <errno.h>
 #include <sys/wait.h>
 #include <sys/uio.h>
+#include <sys/sendfile.h>
 #include <map>
+#include <atomic>
 
 #include "../lock/locker.h"
+#include "../buffer/buffer_pool.h"
+#include "../cache/file_cache.h"
+#include "../cache/response_cache.h"
+#include "../cache/variant_cache.h"
+#include "cache_control.h"
+#include "chunked_decoder.h"
+#include "header_index.h"
+#include "mime_types.h"
+#include "router.h"
+#include "char_scanner.h"
+#include "../threadpool/completion_queue.h"
 #include "../CGImysql/sql_connection_pool.h"
+#include "../CGImysql/user_store.h"
+#include "../CGImysql/user_writer.h"
 #include "../timer/lst_timer.h"
 #include "../log/log.h"
 
@@ -33,8 +48,19 @@ private:
     /* data */
 public:
     static const int FILENAME_LEN = 200;        //文件名最大的长度
-    static const int READ_BUFFER_SIZE = 2048;   //读缓冲区的大小
-    static const int WRITE_BUFFER_SIZE = 1024;  //写缓冲区的大小
+    static const int READ_BUFFER_SIZE = 2048;   //读缓冲区的初始大小,请求较大时按需换成更大一级
+    static const int MAX_READ_BUFFER_SIZE = buffer_pool::MAX_SIZE;  //单个请求的最大长度
+    static const int EXTRA_READ_SIZE = 65536;   //读缓冲区放不下时,readv的第二段栈上缓冲区大小
+    static const int BODY_READ_SIZE = 32768;    //接收消息体时每次至少留出的读缓冲区空间
+    static const int BODY_MEMORY_SIZE = 8192;   //不超过该大小的消息体留在读缓冲区中,更大的写入临时文件
+    static const int MAX_BODY_SIZE = 64 << 20;  //消息体的最大长度
+    static const int SENDFILE_MIN_SIZE = 16384; //不小于该大小的文件用sendfile发送,较小的文件mmap后与响应头一起writev
+    static const int WRITE_BUFFER_SIZE = 8192;  //写缓冲区的大小,流水线中一批请求的应答头依次放在这里
+    static const int RESPONSE_HEADER_SIZE = 2048;   //单个应答在写缓冲区中最多占用的大小,多段Range应答的各段头部也放在这里
+    static const int MAX_RANGES = 8;            //一个请求最多的Range段数,超过时忽略Range发送整个文件
+    static const int MAX_IOV = 2 * MAX_RANGES + 2;  //单个应答最多的段数:应答头、每段的头部和内容、结束分隔符
+    static const int MAX_PIPELINE = 16;         //流水线中最多合并到一次writev发送的应答数
+    static const int IOV_SIZE = MAX_IOV + 2 * MAX_PIPELINE;
 
     enum METHOD {   //Http请求方法
         GET = 0,
@@ -62,7 +88,8 @@ public:
         FORBIDDEN_REQUEST,
         FILE_REQUEST,
         INTERNAL_ERROR,     //服务器内部错误
-        CLOSED_CONNECTION
+        CLOSED_CONNECTION,
+        CACHED_REQUEST      //命中应答缓存,应答头已在写缓冲区中
     };
 
     enum LINE_STATUS {      //标识解析一行的读取状态，从状态机所处的状态。
@@ -72,66 +99,132 @@ public:
     };
 
 public:
-    http_conn() {}
-    ~http_conn() {}
+    http_conn(): m_read_buf(NULL), m_read_size(0), m_body_fd(-1), m_file(NULL), m_file_address(NULL), m_file_fd(-1),
+                 m_held_count(0) {}
+    ~http_conn();
 
 public:
     /* 初始化新接受的连接 */
-    void init(int sockfd, const sockaddr_in& addr, char*, int, int, string user, string passwd, string sqlname);
+    void init(int sockfd, const sockaddr_in& addr, int epollfd, char*, int, int);
     void close_conn(bool real_close = true);    //关闭连接
-    void process();         //处理客户请求
+    bool process();         //处理客户请求,返回false时需要关闭连接
+    void rearm();           //注册工作线程记下的读写事件
     bool read_once();            //非阻塞读操作
-    bool write();           //非阻塞写操作
+    bool write(bool* pending);      //非阻塞写操作,发送完后读缓冲区中还有完整的流水线请求时pending置为true,由调用者交给工作线程
     sockaddr_in* get_address() {
         return &m_address;
     }
-    void initmysql_result(connection_pool* connPool);
-    int timer_flag;
-    int improv;
+    int get_sockfd() {
+        return m_sockfd;
+    }
+    static void initmysql_result(connection_pool* connPool);
+    //注册内置的页面和登录、注册的处理函数,启动时在工作线程开始之前调用
+    static void init_routes();
+    //把读缓冲区归还缓冲区池,请求解析完毕和连接关闭时调用
+    void release_read_buf();
+    //连接关闭、对象归还连接表时释放读缓冲区和文件资源
+    void recycle();
+
+    /*io_uring后端:收发由反应堆提交给内核,http_conn只维护缓冲区和发送进度*/
+    bool read_from(const char* data, int len);      //把内核选出的接收缓冲区中的数据拷入读缓冲区
+    struct iovec* get_iovec(int* count) {
+        *count = m_iv_count - m_iv_idx;
+        return m_iv + m_iv_idx;
+    }
+    bool advance_write(int bytes);      //已发送bytes字节,返回是否还有数据待发送
+    bool finish_write();                //响应发送完毕,返回是否保持连接
+    bool request_ready();               //读缓冲区中已有一个完整的请求还没有处理
+    bool get_linger() {
+        return m_linger;
+    }
+    //当前请求的请求头的值,没有该请求头时返回NULL;值在读缓冲区中,生成应答之前有效
+    const char* header(int name) {
+        return m_headers.value(m_read_buf, name);
+    }
+    const char* header(const char* name) {
+        return m_headers.value(m_read_buf, name);
+    }
+    int timer_flag;     //reactor模式下工作线程读写失败,需要反应堆关闭连接
     
 private:
+    struct byte_range {     //Range中的一段,first和last都包含在内
+        off_t first;
+        off_t last;
+    };
+
     void init();                    //初始化连接
+    void init_request();            //初始化一个请求的解析状态
+    void consume_read();            //丢弃已处理的请求,把流水线中后续请求已读入的部分移到读缓冲区开头
+    bool respond(HTTP_CODE ret);    //为解析完的请求生成应答,追加到待发送的段之后
+    void next_request();            //开始解析流水线中的下一个请求
+    bool batch_room();              //是否还能在本批应答后追加一个应答
     HTTP_CODE process_read();       //解析HTTP请求
     bool process_write(HTTP_CODE ret);   //填充HTTP应答
 
     /*下面这一组函数被process_read调用来分析HTTP请求*/
     HTTP_CODE parse_request_line(char* text);
     HTTP_CODE parse_headers(char* text);
-    HTTP_CODE parse_content(char* text);
+    HTTP_CODE parse_content();
+    bool body_piece(const char* data, int len);     //收到消息体的一段
+    int read_body(char* buf, int len);              //取消息体开头的len个字节,供处理函数使用
+    void close_body();                              //关闭存放消息体的临时文件
     HTTP_CODE do_request();
+    bool read_user_form(char* name, char* password);    //从消息体中取出用户名和密码,没有消息体时返回false
+    static const char* login(http_conn* conn);          //登录的处理函数
+    static const char* sign_up(http_conn* conn);        //注册的处理函数
+    void negotiate_encoding();      //按Accept-Encoding选择目标文件的压缩版本
+    bool lookup_response();         //查找应答缓存,命中时跳过do_request
+    void cache_response();          //把静态文件的应答放入应答缓存
     char* get_line() {return m_read_buf + m_start_line; };
     LINE_STATUS parse_line();
+    bool reserve_read(int len);     //保证读缓冲区还能放下len个字节,必要时换成更大一级
+    bool append_read(const char* data, int len);
 
     /*下面这组函数被process_write调用来填充HTTP应答*/
     void unmap();
+    void release_file();
+    int parse_range(byte_range* ranges);    //解析Range,返回段数;0表示忽略Range,-1表示不可满足
+    bool add_partial(const byte_range* ranges, int n);     //206应答
+    bool add_unsatisfiable();                               //416应答
+    bool not_modified();        //按If-None-Match或If-Modified-Since判断客户端缓存的版本是否仍然有效
+    bool add_not_modified();    //304应答
+    void add_iov(char* base, off_t offset, int len);
+    void add_write_iov();       //写缓冲区中本次应答的部分
+    void add_file_iov(off_t offset, int len);
+    void wait_event(int ev);
     bool add_response(const char* format, ...);
     bool add_content(const char* content);
     bool add_status_line(int status, const char* title);
-    bool add_headers(int content_length);
+    bool add_headers(int content_length, const mime_types::type* type);
     bool add_content_length(int content_length);
-    bool add_content_type();
+    bool add_encoding();
+    bool add_accept_ranges();
+    bool add_validators();
+    bool add_content_type(const mime_types::type* type);
     bool add_linger();
     bool add_blank_line();
 
 public:
-    /*所有socket上的事件都被注册到同一个epoll内核事件中，所有将epoll文件描述符设置为静态的*/
-    static int m_epollfd;
-    static int m_user_count;    //统计用户数量
+    static atomic<int> m_user_count;    //统计用户数量,各反应堆线程并发增减
 
-    MYSQL* mysql;
     int m_state;        //读为0，写为1
+    completion_queue<http_conn>* m_cq;  //所属反应堆的完成队列,reactor模式下工作线程处理完后投递
+    bool m_worker_io;   //reactor模式:读写在工作线程中进行,要等待的事件记在m_state中,由反应堆线程注册
 
 private:
     
     int m_sockfd;       //该HTTP连接的socket
+    int m_epollfd;      //该连接所属反应堆的epoll文件描述符,为-1时由io_uring反应堆负责收发
     sockaddr_in m_address;  //对方的socket地址
 
-    char m_read_buf[READ_BUFFER_SIZE];  //应用程序的读缓冲区
+    char* m_read_buf;       //应用程序的读缓冲区,有数据到达时才从缓冲区池借出
+    int m_read_size;        //读缓冲区的容量
     int m_read_idx;         //标识读缓冲中已经读入的客户数据的最后一个字节的下一个位置
     int m_checked_idx;      //当前正在分析的字符在读缓冲区中的位置
     int m_start_line;       //当前正在解析的行的起始位置
     char m_write_buf[WRITE_BUFFER_SIZE];    //写缓冲区
     int m_write_idx;        //写缓冲区中待发送的字节数
+    int m_write_begin;      //本次应答在写缓冲区中的起始位置,流水线中前面请求的应答在它之前
 
     CHECK_STATE m_check_state;      //主状态机当前所处的状态
     METHOD m_method;            //请求方法
@@ -140,31 +233,43 @@ private:
     char* m_url;        //客户请求的目标文件的文件名
     char* doc_root;     //网站根目录
     char* m_version;    //HTTP协议版本号，本项目只支持HTTP/1.1
-    char* m_host;       //主机名
+    header_index m_headers;     //请求头在读缓冲区中的位置
+    int m_max_age;      //目标文件的Cache-Control max-age,-1表示不发送
+    const mime_types::type* m_mime;     //目标文件的类型,取自文件缓存的条目
     int m_content_length;   //HTTP请求的消息体的长度
+    bool m_chunked;         //消息体使用chunked传输编码
+    chunked_decoder m_chunk;
+    int m_body_start;       //消息体在读缓冲区中的起始位置,之前是请求行和头部
+    int m_body_len;         //留在读缓冲区中的消息体长度,写入临时文件后为0
+    long m_body_size;       //已收到的消息体总长度
+    int m_body_fd;          //存放较大消息体的临时文件,为-1时消息体在读缓冲区中
     bool m_linger;          //HTTP请求是否要求保持连接
+    int m_accept;           //客户端可接受的压缩编码,第i位对应variant_cache::ENCODING中的编码i
+    int m_encoding;         //应答正文使用的压缩编码,-1表示未压缩
+    bool m_vary;            //目标文件可压缩,应答需带Vary头
+    bool m_variant_pending; //可接受的压缩版本正在后台压缩,本次的未压缩应答不放入应答缓存
 
-    char* m_file_address;   //客户请求的目标文件被mmap到内存中的起始位置
+    file_cache::entry* m_file;  //文件缓存中目标文件的条目,应答发送完后归还
+    char* m_file_address;   //客户请求的目标文件被mmap到内存中的起始位置,由文件缓存共享
+    int m_file_fd;          //用sendfile发送的目标文件,为-1时文件内容通过mmap发送,由文件缓存共享
     struct  stat m_file_stat;   //目标文件的状态。通过它可以判断文件是否存在、是否为目录、是否可读，并获取文件的大小等信息
+    file_cache::entry* m_held[MAX_PIPELINE];    //本批中前面各应答的文件条目,整批发送完后归还
+    int m_held_count;
 
-    //因为我们采用writev来执行写操作，所以定义下面这2个成员，m_iv_count表示被写内存块的数量
-    struct  iovec m_iv[2];  
+    //因为我们采用writev来执行写操作，所以定义下面这些成员，m_iv_count表示被写内存块的数量
+    //sendfile发送时iov_base为NULL的一段表示目标文件中从m_iv_off开始的内容
+    //流水线中合并发送的各应答的段依次排列,只有最后一个应答可以用sendfile
+    struct  iovec m_iv[IOV_SIZE];
+    off_t m_iv_off[IOV_SIZE];
     int m_iv_count;
+    int m_iv_idx;       //第一个还没有发送完的段
 
     int cgi;             //是否启用的POST
-    char* m_string;     //存储请求头数据
     int bytes_to_send;  //剩余发送字节数
     int bytes_have_send;    //已发送字节数
-    
 
-    map<string, string> m_users;
     int m_TRIGMode;
     int m_close_log;
-
-    char sql_user[100];
-    char sql_passwd[100];
-    char sql_name[100];
-   
 };
 
 
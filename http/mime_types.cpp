@@ -0,0 +1,81 @@
+#include <string.h>
+#include <strings.h>
+
+#include "mime_types.h"
+
+#define MIME_TYPE(ext, mime) {ext, mime, "Content-Type:" mime "\r\n", sizeof("Content-Type:" mime "\r\n") - 1}
+
+//按扩展名排序,lookup二分查找;网站根目录下的文本文件都是UTF-8编码
+static constexpr mime_types::type TYPES[] = {
+    MIME_TYPE("css", "text/css; charset=utf-8"),
+    MIME_TYPE("gif", "image/gif"),
+    MIME_TYPE("gz", "application/gzip"),
+    MIME_TYPE("htm", "text/html; charset=utf-8"),
+    MIME_TYPE("html", "text/html; charset=utf-8"),
+    MIME_TYPE("ico", "image/x-icon"),
+    MIME_TYPE("jpeg", "image/jpeg"),
+    MIME_TYPE("jpg", "image/jpeg"),
+    MIME_TYPE("js", "text/javascript; charset=utf-8"),
+    MIME_TYPE("json", "application/json"),
+    MIME_TYPE("mp3", "audio/mpeg"),
+    MIME_TYPE("mp4", "video/mp4"),
+    MIME_TYPE("pdf", "application/pdf"),
+    MIME_TYPE("png", "image/png"),
+    MIME_TYPE("svg", "image/svg+xml"),
+    MIME_TYPE("txt", "text/plain; charset=utf-8"),
+    MIME_TYPE("wasm", "application/wasm"),
+    MIME_TYPE("webm", "video/webm"),
+    MIME_TYPE("webp", "image/webp"),
+    MIME_TYPE("woff", "font/woff"),
+    MIME_TYPE("woff2", "font/woff2"),
+    MIME_TYPE("xml", "application/xml"),
+};
+static constexpr int TYPE_COUNT = sizeof(TYPES) / sizeof(TYPES[0]);
+static constexpr mime_types::type DEFAULT_TYPE = MIME_TYPE("", "application/octet-stream");
+static constexpr int HTML_TYPE = 4;
+
+constexpr int compare(const char* a, const char* b) {
+    while (*a && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+constexpr bool sorted() {
+    for (int i = 1; i < TYPE_COUNT; ++i) {
+        if (compare(TYPES[i - 1].extension, TYPES[i].extension) >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(sorted(), "TYPES must be sorted by extension");
+static_assert(compare(TYPES[HTML_TYPE].extension, "html") == 0, "HTML_TYPE must point to html");
+
+const mime_types::type* mime_types::lookup(const char* path) {
+    const char* dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/')) {
+        return &DEFAULT_TYPE;
+    }
+    const char* ext = dot + 1;
+    int low = 0, high = TYPE_COUNT - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int cmp = strcasecmp(ext, TYPES[mid].extension);
+        if (cmp == 0) {
+            return &TYPES[mid];
+        }
+        if (cmp < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return &DEFAULT_TYPE;
+}
+
+const mime_types::type* mime_types::html() {
+    return &TYPES[HTML_TYPE];
+}
@@ -0,0 +1,21 @@
+#ifndef MIME_TYPES_H
+#define MIME_TYPES_H
+
+//按扩展名确定文件的MIME类型,表在编译期生成,每一项带有预先拼好的Content-Type头部行
+//文件缓存加载文件时查一次,结果随文件条目缓存,生成应答时直接拷贝头部行
+class mime_types {
+public:
+    struct type {
+        const char* extension;  //小写,不带.
+        const char* mime;
+        const char* header;     //"Content-Type:<mime>\r\n"
+        int header_len;
+    };
+
+    //path的扩展名对应的类型,扩展名不区分大小写,没有扩展名或扩展名未知时返回application/octet-stream
+    static const type* lookup(const char* path);
+    //错误页面等服务器生成的HTML内容的类型
+    static const type* html();
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <string.h>
+#include "router.h"
+
+//使用局部静态变量懒汉模式创建路由表
+router* router::get_instance() {
+    static router instance;
+    return &instance;
+}
+
+router::router() {
+    m_nodes.resize(1);
+    memset(&m_nodes[0], 0, sizeof(node));
+}
+
+bool router::add(int methods, const char* path, const char* file) {
+    route r = {file, NULL};
+    return insert(methods, path, r);
+}
+
+bool router::add(int methods, const char* path, handler func) {
+    route r = {NULL, func};
+    return insert(methods, path, r);
+}
+
+bool router::insert(int methods, const char* path, const route& r) {
+    if (path[0] != '/') {
+        return false;
+    }
+    int cur = 0;
+    for (const char* p = path; *p; ++p) {
+        unsigned char c = *p;
+        if (c >= 128 || c == '?') {
+            return false;
+        }
+        if (m_nodes[cur].next[c] == 0) {
+            node n;
+            memset(&n, 0, sizeof(n));
+            m_nodes.push_back(n);
+            m_nodes[cur].next[c] = m_nodes.size() - 1;
+        }
+        cur = m_nodes[cur].next[c];
+    }
+    for (int i = 0; i < METHOD_NUM; ++i) {
+        if (methods & (1 << i)) {
+            m_nodes[cur].routes[i] = r;
+        }
+    }
+    return true;
+}
+
+const router::route* router::find(int method, const char* path) const {
+    int cur = 0;
+    for (const char* p = path; *p && *p != '?'; ++p) {
+        unsigned char c = *p;
+        if (c >= 128 || m_nodes[cur].next[c] == 0) {
+            return NULL;
+        }
+        cur = m_nodes[cur].next[c];
+    }
+    const route* r = &m_nodes[cur].routes[method];
+    return (r->file || r->func) ? r : NULL;
+}
@@ -0,0 +1,46 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <vector>
+
+class http_conn;
+
+//路由表:按请求方法和路径把请求交给静态页面或动态处理函数,没有匹配的路由时由调用者按url发送网站根目录下的文件
+//路径存放在字符前缀树中,查找时逐字符向下走一步,耗时与路径长度成正比,不分配内存
+//路由在启动时、工作线程开始之前注册,之后只读,查找不需要加锁
+class router {
+public:
+    //动态处理函数,返回要发送的页面(网站根目录下的路径),返回NULL时按资源不存在处理
+    typedef const char* (*handler)(http_conn* conn);
+
+    struct route {
+        const char* file;   //静态页面,动态路由为NULL
+        handler func;       //动态处理函数,静态路由为NULL
+    };
+
+    static const int METHOD_NUM = 9;    //与http_conn::METHOD中的方法数一致
+
+    //单例模式
+    static router* get_instance();
+
+    //methods为方法的位掩码,第i位对应http_conn::METHOD中的方法i;同一方法和路径再次注册时覆盖
+    //路径必须以/开头且只含ASCII字符,否则返回false
+    bool add(int methods, const char* path, const char* file);
+    bool add(int methods, const char* path, handler func);
+    //按方法和路径查找,路径在?处结束,没有匹配的路由时返回NULL
+    const route* find(int method, const char* path) const;
+
+private:
+    struct node {
+        unsigned short next[128];   //下一个字符对应的结点,0表示没有(根结点不会成为子结点)
+        route routes[METHOD_NUM];   //在此结束的路径上各方法的路由,file和func都为NULL表示没有
+    };
+
+    router();
+
+    bool insert(int methods, const char* path, const route& r);
+
+    std::vector<node> m_nodes;
+};
+
+#endif
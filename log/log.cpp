@@ -129,7 +129,11 @@ void Log::write_log(int level, const char* format, ...) {
                      my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday,
                      my_tm.tm_hour, my_tm.tm_min, my_tm.tm_sec, now.tv_usec, s);
     //内容格式化，用于向字符串中打印数据、数据格式用户自定义，返回写入到字符数组str中的字符个数(不包含终止符
-    int m = vsnprintf(m_buf + n, m_log_buf_size - 1, format, valst);
+    int m = vsnprintf(m_buf + n, m_log_buf_size - n - 1, format, valst);
+    //内容过长时vsnprintf返回完整的长度,按实际写入的长度截断,留出换行符和终止符的位置
+    if (m > m_log_buf_size - n - 2) {
+        m = m_log_buf_size - n - 2;
+    }
     m_buf[n + m] = '\n';
     m_buf[n + m + 1] = '\0';
     log_str = m_buf;
@@ -15,8 +15,8 @@ int main(int argc, char* argv[]) {
 
     //初始化
     server.init(config.PORT, user, passwd, databasename, config.LOGWrite,
-    config.OPT_LINGER, config.TRIGMode, config.sql_num, config.thread_num,
-    config.close_log, config.actor_model);
+    config.OPT_LINGER, config.TRIGMode, config.sql_min_num, config.sql_num, config.thread_num,
+    config.close_log, config.actor_model, config.reactor_num, config.cache_control, config.register_ack);
     
     //日志
     server.log_write();
@@ -24,12 +24,12 @@ int main(int argc, char* argv[]) {
     //数据库
     server.sql_pool();
 
+    //触发模式,io_uring后端会影响线程池的并发模型,因此先于线程池确定
+    server.trig_mode();
+
     //线程池
     server.thread_pool();
 
-    //触发模式
-    server.trig_mode();
-
     //监听
     server.eventListen();
 
@@ -0,0 +1,110 @@
+#include "test.h"
+#include "../http/char_scanner.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//分隔字符查找的测试:每个实现都与逐字节查找的结果比较
+//数据放在一页的末尾,下一页不可访问,实现越过end读取时测试进程会崩溃
+
+static const char* IMPLS[] = {"avx2", "sse2", "scalar"};
+static const int IMPLS_COUNT = sizeof(IMPLS) / sizeof(IMPLS[0]);
+
+static const char* naive_find(const char* p, const char* end, char a, char b) {
+    while (p < end && *p != a && *p != b) {
+        ++p;
+    }
+    return p;
+}
+
+//两页内存,第二页设为不可访问,返回第一页的末尾
+static char* guarded_end() {
+    long page = sysconf(_SC_PAGESIZE);
+    char* mem = (char*)mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(mem != MAP_FAILED);
+    CHECK(mprotect(mem + page, page, PROT_NONE) == 0);
+    return mem + page;
+}
+
+//当前实现对[begin, end)的查找结果与逐字节查找一致
+static void check_find(const char* begin, const char* end, char a, char b) {
+    CHECK(char_scanner::find(begin, end, a, b) == naive_find(begin, end, a, b));
+}
+
+//默认选用的实现是支持的实现之一,可以换回来
+static void test_default_impl() {
+    const char* name = char_scanner::name();
+    CHECK(name[0] != '\0');
+    CHECK(char_scanner::use(name));
+    CHECK(!char_scanner::use("neon"));
+    CHECK(char_scanner::use("scalar"));
+    CHECK(strcmp(char_scanner::name(), "scalar") == 0);
+}
+
+//各种长度和位置:目标字符在每个位置(包括向量块的边界和不足一块的尾部)、两个目标都出现、没有目标
+static void test_positions() {
+    char* end = guarded_end();
+    for (int i = 0; i < IMPLS_COUNT; ++i) {
+        if (!char_scanner::use(IMPLS[i])) {
+            continue;
+        }
+        for (int len = 0; len <= 100; ++len) {
+            char* begin = end - len;
+            memset(begin, 'x', len);
+            check_find(begin, end, '\r', '\n');
+            for (int pos = 0; pos < len; ++pos) {
+                begin[pos] = '\n';
+                check_find(begin, end, '\r', '\n');
+                //更靠前的另一个目标字符先被找到
+                for (int first = 0; first < pos; first += 7) {
+                    begin[first] = '\r';
+                    check_find(begin, end, '\r', '\n');
+                    begin[first] = 'x';
+                }
+                begin[pos] = 'x';
+            }
+        }
+    }
+}
+
+//随机数据:字节值取全部256种(包括负的char),与目标字符只差高位的字节不能被误认
+static void test_random() {
+    char* end = guarded_end();
+    const int MAX_LEN = 300;
+    srand(12345);
+    for (int i = 0; i < IMPLS_COUNT; ++i) {
+        if (!char_scanner::use(IMPLS[i])) {
+            continue;
+        }
+        for (int round = 0; round < 20000; ++round) {
+            int len = rand() % (MAX_LEN + 1);
+            char* begin = end - len;
+            int density = 1 + rand() % 200;
+            for (int k = 0; k < len; ++k) {
+                int r = rand();
+                if (r % density == 0) {
+                    begin[k] = r & 1 ? ':' : ' ';
+                } else {
+                    begin[k] = (char)(r >> 8);
+                }
+            }
+            check_find(begin, end, ':', ' ');
+            check_find(begin, end, '\r', '\n');
+            check_find(begin, end, (char)0x8a, (char)0x8d);
+            //从中间开始的查找,起点不对齐
+            int skip = len ? rand() % len : 0;
+            check_find(begin + skip, end, ':', ' ');
+        }
+    }
+}
+
+int main() {
+    static const test_case cases[] = {
+        {"default_impl", test_default_impl},
+        {"positions", test_positions},
+        {"random", test_random},
+    };
+    return run_tests(cases, sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,267 @@
+#include <pthread.h>
+#include "test.h"
+#include "stub/mysql_stub.h"
+#include "../CGImysql/sql_connection_pool.h"
+
+//连接池的测试,数据库由test/stub中的替身模拟
+//三个时间缩短为:取连接等待200ms,空闲100ms后借出前ping,超出最小连接数的空闲300ms后关闭
+
+static const int ACQUIRE_MS = 200;
+static const int VALIDATE_MS = 100;
+static const int MAX_IDLE_MS = 300;
+
+static connection_pool* make_pool(int min_conn, int max_conn) {
+    connection_pool* pool = connection_pool::GetInstance();
+    pool->SetTimeouts(ACQUIRE_MS, VALIDATE_MS, MAX_IDLE_MS);
+    pool->init("localhost", "root", "root", "db", 3306, min_conn, max_conn, 1);
+    return pool;
+}
+
+//启动时建立最小连接数条,不够用时在最大连接数以内新建
+static void test_grow() {
+    connection_pool* pool = make_pool(1, 3);
+    CHECK(mysql_stub::connects() == 1);
+    MYSQL* a = pool->GetConnection();
+    MYSQL* b = pool->GetConnection();
+    CHECK(a && b && a != b);
+    CHECK(mysql_stub::connects() == 2);
+    connection_pool::stats s = pool->GetStats();
+    CHECK(s.total == 2 && s.in_use == 2 && s.idle == 0);
+    pool->ReleaseConnection(b);
+    //优先借出最近归还的连接
+    CHECK(pool->GetConnection() == b);
+    pool->ReleaseConnection(a);
+    pool->ReleaseConnection(b);
+    s = pool->GetStats();
+    CHECK(s.total == 2 && s.in_use == 0 && s.idle == 2 && s.acquired == 3);
+}
+
+//已达最大连接数且没有归还时,等待m_acquire_timeout后返回NULL
+static void test_timeout() {
+    connection_pool* pool = make_pool(1, 2);
+    MYSQL* a = pool->GetConnection();
+    MYSQL* b = pool->GetConnection();
+    CHECK(a && b);
+    int64_t start = test_now_ms();
+    CHECK(pool->GetConnection() == NULL);
+    int64_t elapsed = test_now_ms() - start;
+    CHECK(elapsed >= ACQUIRE_MS && elapsed < ACQUIRE_MS + 500);
+    connection_pool::stats s = pool->GetStats();
+    CHECK(s.timeouts == 1 && s.waiters == 0 && s.in_use == 2);
+    CHECK(mysql_stub::connects() == 2);
+    pool->ReleaseConnection(a);
+    pool->ReleaseConnection(b);
+}
+
+static void* release_later(void* arg) {
+    usleep(50 * 1000);
+    connection_pool::GetInstance()->ReleaseConnection((MYSQL*)arg);
+    return NULL;
+}
+
+//等待中的线程在连接归还时被唤醒,计入waited
+static void test_wait_for_release() {
+    connection_pool* pool = make_pool(1, 1);
+    MYSQL* a = pool->GetConnection();
+    CHECK(a);
+    pthread_t tid;
+    pthread_create(&tid, NULL, release_later, a);
+    int64_t start = test_now_ms();
+    MYSQL* b = pool->GetConnection();
+    int64_t elapsed = test_now_ms() - start;
+    pthread_join(tid, NULL);
+    CHECK(b == a);
+    CHECK(elapsed < ACQUIRE_MS);
+    connection_pool::stats s = pool->GetStats();
+    CHECK(s.waited == 1 && s.timeouts == 0 && s.max_wait_us > 0);
+    pool->ReleaseConnection(b);
+}
+
+//超出最小连接数的连接空闲超过m_max_idle后,在之后的归还中逐条关闭,直到回到最小连接数
+static void test_shrink_to_min() {
+    connection_pool* pool = make_pool(1, 4);
+    MYSQL* con[4];
+    for (int i = 0; i < 4; ++i) {
+        con[i] = pool->GetConnection();
+        CHECK(con[i]);
+    }
+    for (int i = 0; i < 4; ++i) {
+        pool->ReleaseConnection(con[i]);
+    }
+    CHECK(pool->GetStats().total == 4);
+    //未到空闲时间时不关闭
+    pool->ReleaseConnection(pool->GetConnection());
+    CHECK(pool->GetStats().total == 4);
+
+    usleep((MAX_IDLE_MS + 50) * 1000);
+    for (int i = 0; i < 10 && pool->GetStats().total > 1; ++i) {
+        pool->ReleaseConnection(pool->GetConnection());
+    }
+    connection_pool::stats s = pool->GetStats();
+    CHECK(s.total == 1 && s.idle == 1);
+    CHECK(mysql_stub::closes() == 3);
+    CHECK(mysql_stub::open_connections() == 1);
+    //不会低于最小连接数
+    usleep((MAX_IDLE_MS + 50) * 1000);
+    pool->ReleaseConnection(pool->GetConnection());
+    CHECK(pool->GetStats().total == 1);
+}
+
+//数据库重启后,空闲过m_validate_idle的连接借出前ping失败,关闭后重新建立
+static void test_reconnect_on_ping_failure() {
+    connection_pool* pool = make_pool(1, 1);
+    MYSQL* con = pool->GetConnection();
+    CHECK(con);
+    pool->ReleaseConnection(con);
+    //刚归还的连接不ping
+    int pings = mysql_stub::pings();
+    pool->ReleaseConnection(pool->GetConnection());
+    CHECK(mysql_stub::pings() == pings);
+
+    mysql_stub::restart();
+    usleep((VALIDATE_MS + 50) * 1000);
+    con = pool->GetConnection();
+    CHECK(con);
+    CHECK(mysql_stub::pings() == pings + 1);
+    CHECK(mysql_ping(con) == 0);
+    connection_pool::stats s = pool->GetStats();
+    CHECK(s.reconnects == 1 && s.total == 1 && s.in_use == 1);
+    CHECK(mysql_stub::connects() == 2 && mysql_stub::open_connections() == 1);
+    pool->ReleaseConnection(con);
+}
+
+//归还时最后一次操作报告连接断开的,关闭并让出名额,下次借出时重新建立
+static void test_broken_on_release() {
+    connection_pool* pool = make_pool(1, 1);
+    MYSQL* con = pool->GetConnection();
+    CHECK(con);
+    mysql_stub::lose(con);
+    pool->ReleaseConnection(con);
+    connection_pool::stats s = pool->GetStats();
+    CHECK(s.broken == 1 && s.total == 0 && s.idle == 0);
+    CHECK(mysql_stub::open_connections() == 0);
+    con = pool->GetConnection();
+    CHECK(con && mysql_ping(con) == 0);
+    pool->ReleaseConnection(con);
+}
+
+//数据库不可用时取连接返回NULL而不阻塞,名额交还,恢复后可以再建立
+static void test_database_down() {
+    mysql_stub::set_down(true);
+    connection_pool* pool = make_pool(2, 2);
+    connection_pool::stats s = pool->GetStats();
+    CHECK(s.total == 0);
+    int64_t start = test_now_ms();
+    CHECK(pool->GetConnection() == NULL);
+    CHECK(test_now_ms() - start < ACQUIRE_MS);
+    s = pool->GetStats();
+    CHECK(s.connect_failures == 1 && s.total == 0 && s.in_use == 0 && s.acquired == 0);
+    mysql_stub::set_down(false);
+    MYSQL* con = pool->GetConnection();
+    CHECK(con);
+    pool->ReleaseConnection(con);
+}
+
+//销毁后取连接返回NULL,借出的连接在归还时关闭
+static void test_destroy() {
+    connection_pool* pool = make_pool(2, 2);
+    MYSQL* con = pool->GetConnection();
+    CHECK(con);
+    pool->DestroyPool();
+    CHECK(mysql_stub::open_connections() == 1);
+    CHECK(pool->GetConnection() == NULL);
+    pool->ReleaseConnection(con);
+    CHECK(mysql_stub::open_connections() == 0);
+    CHECK(pool->GetStats().total == 0);
+}
+
+static const char* SELECT_SQL = "SELECT passwd FROM user WHERE username = ?";
+
+//同一SQL在一条连接上只预处理一次
+static void test_prepare_once() {
+    connection_pool* pool = make_pool(1, 1);
+    MYSQL* con = pool->GetConnection();
+    MYSQL_STMT* stmt = pool->Prepare(con, SELECT_SQL);
+    CHECK(stmt);
+    CHECK(pool->Prepare(con, SELECT_SQL) == stmt);
+    CHECK(mysql_stub::prepares() == 1);
+    CHECK(mysql_stmt_execute(stmt) == 0);
+    pool->ReleaseConnection(con);
+    con = pool->GetConnection();
+    CHECK(pool->Prepare(con, SELECT_SQL) == stmt);
+    CHECK(mysql_stub::prepares() == 1);
+    pool->ReleaseConnection(con);
+}
+
+//ping失败重建的连接上重新预处理,不沿用旧连接上的语句,即使新连接复用了旧连接的地址
+static void test_prepare_after_reconnect() {
+    connection_pool* pool = make_pool(1, 1);
+    MYSQL* con = pool->GetConnection();
+    CHECK(pool->Prepare(con, SELECT_SQL));
+    pool->ReleaseConnection(con);
+    mysql_stub::restart();
+    usleep((VALIDATE_MS + 50) * 1000);
+    con = pool->GetConnection();
+    CHECK(con && pool->GetStats().reconnects == 1);
+    CHECK(mysql_stub::open_statements() == 0);
+    MYSQL_STMT* stmt = pool->Prepare(con, SELECT_SQL);
+    CHECK(stmt);
+    CHECK(mysql_stub::prepares() == 2);
+    CHECK(mysql_stmt_execute(stmt) == 0);
+    pool->ReleaseConnection(con);
+}
+
+//归还时断开、收缩关闭的连接上的语句随连接关闭
+static void test_statements_closed_with_connection() {
+    connection_pool* pool = make_pool(1, 2);
+    MYSQL* a = pool->GetConnection();
+    MYSQL* b = pool->GetConnection();
+    CHECK(pool->Prepare(a, SELECT_SQL) && pool->Prepare(b, SELECT_SQL));
+    CHECK(mysql_stub::open_statements() == 2);
+    mysql_stub::lose(b);
+    pool->ReleaseConnection(b);
+    CHECK(mysql_stub::open_statements() == 1);
+    pool->ReleaseConnection(a);
+    b = pool->GetConnection();
+    MYSQL* c = pool->GetConnection();
+    CHECK(b == a && c);
+    CHECK(pool->Prepare(c, SELECT_SQL));
+    CHECK(mysql_stub::open_statements() == 2);
+    pool->ReleaseConnection(c);
+    pool->ReleaseConnection(b);
+    usleep((MAX_IDLE_MS + 50) * 1000);
+    pool->ReleaseConnection(pool->GetConnection());
+    CHECK(pool->GetStats().total == 1);
+    CHECK(mysql_stub::open_statements() == 1);
+}
+
+//不是由连接池建立的连接不能预处理
+static void test_prepare_unknown_connection() {
+    connection_pool* pool = make_pool(1, 1);
+    MYSQL* con = pool->Connect();
+    CHECK(con && pool->Prepare(con, SELECT_SQL));
+    pool->Close(con);
+    MYSQL* other = mysql_init(NULL);
+    CHECK(mysql_real_connect(other, "localhost", "root", "root", "db", 3306, NULL, 0));
+    CHECK(pool->Prepare(other, SELECT_SQL) == NULL);
+    CHECK(mysql_stub::open_statements() == 0);
+    mysql_close(other);
+}
+
+int main() {
+    static const test_case cases[] = {
+        {"grow", test_grow},
+        {"timeout", test_timeout},
+        {"wait_for_release", test_wait_for_release},
+        {"shrink_to_min", test_shrink_to_min},
+        {"reconnect_on_ping_failure", test_reconnect_on_ping_failure},
+        {"broken_on_release", test_broken_on_release},
+        {"database_down", test_database_down},
+        {"destroy", test_destroy},
+        {"prepare_once", test_prepare_once},
+        {"prepare_after_reconnect", test_prepare_after_reconnect},
+        {"statements_closed_with_connection", test_statements_closed_with_connection},
+        {"prepare_unknown_connection", test_prepare_unknown_connection},
+    };
+    return run_tests(cases, sizeof(cases) / sizeof(cases[0]));
+}
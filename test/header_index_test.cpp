@@ -0,0 +1,183 @@
+#include "test.h"
+#include "../http/header_index.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+//请求头索引的测试:完美哈希表对已知名字的识别,以及请求头行的切分和取值
+
+//与header_index::NAME对应的名字,在测试中独立写出,不依赖header_index.cpp中的表
+static const struct {
+    const char* name;
+    int id;
+} KNOWN[] = {
+    {"Host", header_index::HOST},
+    {"Connection", header_index::CONNECTION},
+    {"Content-Length", header_index::CONTENT_LENGTH},
+    {"Content-Type", header_index::CONTENT_TYPE},
+    {"Transfer-Encoding", header_index::TRANSFER_ENCODING},
+    {"Expect", header_index::EXPECT},
+    {"Accept", header_index::ACCEPT},
+    {"Accept-Encoding", header_index::ACCEPT_ENCODING},
+    {"Accept-Language", header_index::ACCEPT_LANGUAGE},
+    {"Range", header_index::RANGE},
+    {"If-Range", header_index::IF_RANGE},
+    {"If-Match", header_index::IF_MATCH},
+    {"If-None-Match", header_index::IF_NONE_MATCH},
+    {"If-Modified-Since", header_index::IF_MODIFIED_SINCE},
+    {"If-Unmodified-Since", header_index::IF_UNMODIFIED_SINCE},
+    {"Cache-Control", header_index::CACHE_CONTROL},
+    {"Cookie", header_index::COOKIE},
+    {"Authorization", header_index::AUTHORIZATION},
+    {"User-Agent", header_index::USER_AGENT},
+    {"Referer", header_index::REFERER},
+    {"Origin", header_index::ORIGIN},
+    {"Upgrade", header_index::UPGRADE},
+};
+static const int KNOWN_SIZE = sizeof(KNOWN) / sizeof(KNOWN[0]);
+
+static int lookup(const std::string& name) {
+    return header_index::lookup(name.data(), name.size());
+}
+
+//与某个已知名字只有大小写不同时返回它的编号
+static int known_id(const std::string& name) {
+    for (int i = 0; i < KNOWN_SIZE; ++i) {
+        if (name.size() == strlen(KNOWN[i].name) && strncasecmp(name.data(), KNOWN[i].name, name.size()) == 0) {
+            return KNOWN[i].id;
+        }
+    }
+    return header_index::UNKNOWN;
+}
+
+//每个已知名字都能识别,不区分大小写,编号互不相同
+static void test_known_names() {
+    CHECK(KNOWN_SIZE == header_index::KNOWN_COUNT);
+    for (int i = 0; i < KNOWN_SIZE; ++i) {
+        std::string name = KNOWN[i].name;
+        CHECK(lookup(name) == KNOWN[i].id);
+        std::string lower = name, upper = name, mixed = name;
+        for (size_t k = 0; k < name.size(); ++k) {
+            lower[k] = tolower(name[k]);
+            upper[k] = toupper(name[k]);
+            mixed[k] = k % 2 ? lower[k] : upper[k];
+        }
+        CHECK(lookup(lower) == KNOWN[i].id);
+        CHECK(lookup(upper) == KNOWN[i].id);
+        CHECK(lookup(mixed) == KNOWN[i].id);
+    }
+}
+
+//前缀、加长、空名字和其他常见请求头不会被识别成已知请求头
+static void test_unknown_names() {
+    const char* names[] = {"", "X", "Hos", "Hostname", "Content", "Content-", "Content-Lengths", "Accept-Charset",
+                           "X-Forwarded-For", "Keep-Alive", "Pragma", "DNT", "Via", "TE", "Date"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        CHECK(lookup(names[i]) == header_index::UNKNOWN);
+    }
+    //只按len比较,缓冲区中名字之后的字符不参与
+    CHECK(header_index::lookup("Hostname", 4) == header_index::HOST);
+    CHECK(header_index::lookup("Range: bytes", 5) == header_index::RANGE);
+}
+
+//哈希时字母转小写用的是|0x20,'-'与'\r'、'@'与'`'等字符落在同一个槽,必须靠名字比较区分
+static void test_near_misses() {
+    for (int i = 0; i < KNOWN_SIZE; ++i) {
+        std::string name = KNOWN[i].name;
+        for (size_t k = 0; k < name.size(); ++k) {
+            std::string changed = name;
+            changed[k] = name[k] ^ 0x20;
+            //字母只改变了大小写
+            int expect = isalpha((unsigned char)name[k]) ? KNOWN[i].id : header_index::UNKNOWN;
+            CHECK(lookup(changed) == expect);
+        }
+        std::string dash = name;
+        for (size_t k = 0; k < dash.size(); ++k) {
+            if (dash[k] == '-') {
+                dash[k] = '\r';
+                CHECK(lookup(dash) == header_index::UNKNOWN);
+                dash[k] = '_';
+                CHECK(lookup(dash) == header_index::UNKNOWN);
+                dash[k] = '-';
+            }
+        }
+    }
+    //随机改动已知名字中的一个字符,只有改成同一字母的另一种大小写时才能识别
+    srand(54321);
+    for (int round = 0; round < 200000; ++round) {
+        std::string name = KNOWN[rand() % KNOWN_SIZE].name;
+        name[rand() % name.size()] = (char)(1 + rand() % 255);
+        CHECK(lookup(name) == known_id(name));
+    }
+}
+
+//把请求头行放进缓冲区,返回add的结果
+static int add_line(header_index& index, std::string& buf, const char* line) {
+    int off = buf.size();
+    buf += line;
+    buf += '\0';
+    return index.add(&buf[0], off, strlen(line));
+}
+
+//请求头行的切分:值去掉首尾空白,同名的已知请求头取第一个,其他请求头按名字顺序查找
+static void test_add_and_value() {
+    header_index index;
+    std::string buf;
+    buf.reserve(4096);      //add记录的是偏移,但测试中取值时直接用buf.data(),不能重新分配
+    CHECK(add_line(index, buf, "host: example.com") == 0);
+    CHECK(add_line(index, buf, "Content-Length:\t 42 \t") == 1);
+    CHECK(add_line(index, buf, "X-Custom:  a b  ") == 2);
+    CHECK(add_line(index, buf, "HOST: second") == 3);
+    CHECK(add_line(index, buf, "Empty:") == 4);
+    CHECK(index.count() == 5);
+
+    const char* data = buf.data();
+    int len = 0;
+    CHECK(strcmp(index.value(data, header_index::HOST, &len), "example.com") == 0 && len == 11);
+    CHECK(strcmp(index.value(data, header_index::CONTENT_LENGTH), "42") == 0);
+    CHECK(strcmp(index.value(data, "content-length"), "42") == 0);
+    CHECK(strcmp(index.value(data, "x-custom", &len), "a b") == 0 && len == 3);
+    CHECK(strcmp(index.value(data, "EMPTY", &len), "") == 0 && len == 0);
+    CHECK(index.value(data, header_index::RANGE) == NULL);
+    CHECK(index.value(data, "X-Missing") == NULL);
+    CHECK(index.at(3).name == header_index::HOST);
+    CHECK(index.at(2).name == header_index::UNKNOWN);
+
+    index.clear();
+    CHECK(index.count() == 0);
+    CHECK(index.value(data, header_index::HOST) == NULL);
+}
+
+//格式错误的请求头行和过多的请求头被拒绝
+static void test_bad_lines() {
+    header_index index;
+    std::string buf;
+    buf.reserve(64 * 1024);
+    const char* bad[] = {"NoColon", ": no name", "Host : x", "Ho st: x", "Ho\tst: x", " Host: folded"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        CHECK(add_line(index, buf, bad[i]) == -1);
+    }
+    std::string long_name(header_index::MAX_NAME_LENGTH + 1, 'a');
+    CHECK(add_line(index, buf, (long_name + ": x").c_str()) == -1);
+    CHECK(index.count() == 0);
+
+    for (int i = 0; i < header_index::MAX_HEADERS; ++i) {
+        CHECK(add_line(index, buf, "X-Many: 1") == i);
+    }
+    CHECK(add_line(index, buf, "Host: x") == -1);
+    CHECK(index.count() == header_index::MAX_HEADERS);
+}
+
+int main() {
+    static const test_case cases[] = {
+        {"known_names", test_known_names},
+        {"unknown_names", test_unknown_names},
+        {"near_misses", test_near_misses},
+        {"add_and_value", test_add_and_value},
+        {"bad_lines", test_bad_lines},
+    };
+    return run_tests(cases, sizeof(cases) / sizeof(cases[0]));
+}
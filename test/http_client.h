@@ -0,0 +1,240 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+//HTTP测试的公共部分:在子进程中运行用MySQL替身编译的服务器test/server_stub,通过socket发送原始请求并解析应答
+//服务器以仓库根目录为工作目录运行,网站根目录是root;用例进程退出时结束服务器
+
+struct http_response {
+    int status;
+    std::string head;       //状态行和头部的原文,不含结尾的空行
+    std::map<std::string, std::string> headers;     //名称转为小写
+    std::string body;
+
+    const char* header(const char* name) const {
+        std::map<std::string, std::string>::const_iterator it = headers.find(name);
+        return it != headers.end() ? it->second.c_str() : NULL;
+    }
+};
+
+static pid_t g_server_pid = -1;
+
+static void stop_server() {
+    if (g_server_pid > 0) {
+        kill(g_server_pid, SIGTERM);
+        waitpid(g_server_pid, NULL, 0);
+        g_server_pid = -1;
+    }
+}
+
+//内核选一个空闲端口
+static int free_port() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &len);
+    close(fd);
+    return ntohs(addr.sin_port);
+}
+
+static int try_connect(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//启动服务器并等它开始监听,返回端口;args是附加的命令行参数,例如"-m", "4"
+static int start_server(const std::vector<std::string>& args = std::vector<std::string>()) {
+    int port = free_port();
+    char port_arg[16];
+    snprintf(port_arg, sizeof(port_arg), "%d", port);
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::vector<const char*> argv;
+        argv.push_back("./test/server_stub");
+        argv.push_back("-p");
+        argv.push_back(port_arg);
+        argv.push_back("-c");
+        argv.push_back("1");
+        for (size_t i = 0; i < args.size(); ++i) {
+            argv.push_back(args[i].c_str());
+        }
+        argv.push_back(NULL);
+        //关闭连接时服务器会打印到标准输出,不混进测试结果
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        execv(argv[0], (char* const*)&argv[0]);
+        _exit(127);
+    }
+    g_server_pid = pid;
+    atexit(stop_server);
+    for (int i = 0; i < 300; ++i) {
+        int fd = try_connect(port);
+        if (fd != -1) {
+            close(fd);
+            return port;
+        }
+        CHECK(waitpid(pid, NULL, WNOHANG) == 0);
+        usleep(10 * 1000);
+    }
+    CHECK(!"server did not start");
+    return -1;
+}
+
+//建立连接,读写超时2秒
+static int connect_server(int port) {
+    int fd = try_connect(port);
+    CHECK(fd != -1);
+    struct timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static void send_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        CHECK(n > 0);
+        sent += n;
+    }
+}
+
+//组装一个请求,extra是附加的请求头,每行以\r\n结尾
+static std::string make_request(const char* method, const char* path, const std::string& extra = "", bool keep_alive = true,
+                                const std::string& body = "") {
+    std::string req = std::string(method) + " " + path + " HTTP/1.1\r\nHost: localhost\r\n";
+    req += keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    req += extra;
+    if (!body.empty()) {
+        char len[64];
+        snprintf(len, sizeof(len), "Content-Length: %d\r\n", (int)body.size());
+        req += len;
+    }
+    return req + "\r\n" + body;
+}
+
+static std::string get_request(const char* path, const std::string& extra = "", bool keep_alive = true) {
+    return make_request("GET", path, extra, keep_alive);
+}
+
+//连接的接收缓冲,一次recv可能包含多个应答
+struct http_stream {
+    int fd;
+    std::string buf;
+    bool eof;
+
+    explicit http_stream(int fd_): fd(fd_), eof(false) {}
+    ~http_stream() { close(fd); }
+
+    bool fill() {
+        char data[65536];
+        ssize_t n = recv(fd, data, sizeof(data), 0);
+        //n小于0是超时,连接没有关闭
+        if (n <= 0) {
+            eof = eof || n == 0;
+            return false;
+        }
+        buf.append(data, n);
+        return true;
+    }
+
+    //读出下一个应答,连接关闭或超时时返回false;head_only为true时应答没有消息体(HEAD请求)
+    bool read(http_response& r, bool head_only = false) {
+        size_t end;
+        while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        std::string& head = r.head;
+        head = buf.substr(0, end);
+        r.headers.clear();
+        r.body.clear();
+        r.status = atoi(head.c_str() + head.find(' ') + 1);
+        size_t line = head.find("\r\n");
+        while (line != std::string::npos) {
+            size_t next = head.find("\r\n", line + 2);
+            std::string text = head.substr(line + 2, next == std::string::npos ? std::string::npos : next - line - 2);
+            size_t colon = text.find(':');
+            if (colon != std::string::npos) {
+                std::string name = text.substr(0, colon);
+                for (size_t i = 0; i < name.size(); ++i) {
+                    name[i] = tolower(name[i]);
+                }
+                size_t value = text.find_first_not_of(' ', colon + 1);
+                r.headers[name] = value == std::string::npos ? "" : text.substr(value);
+            }
+            line = next;
+        }
+        size_t length = 0;
+        if (!head_only && r.status != 304 && r.header("content-length")) {
+            length = atol(r.header("content-length"));
+        }
+        while (buf.size() < end + 4 + length) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        r.body = buf.substr(end + 4, length);
+        buf.erase(0, end + 4 + length);
+        return true;
+    }
+
+    //服务器是否已关闭连接(已缓存的数据读完之后),2秒内既没有数据也没有关闭时返回false
+    bool closed() {
+        if (!buf.empty()) {
+            return false;
+        }
+        while (!eof && fill()) {
+            if (!buf.empty()) {
+                return false;
+            }
+        }
+        return eof;
+    }
+};
+
+//读出root下的文件内容,用来比较应答的消息体
+static std::string read_file(const char* path) {
+    std::string name = std::string("./root") + path;
+    FILE* fp = fopen(name.c_str(), "rb");
+    CHECK(fp);
+    std::string data;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        data.append(buf, n);
+    }
+    fclose(fp);
+    return data;
+}
+
+#endif
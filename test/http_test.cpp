@@ -0,0 +1,403 @@
+#include <zlib.h>
+#include "http_client.h"
+
+//HTTP层的测试,服务器由test/server_stub在子进程中运行
+
+//各种执行模式:默认的proactor、reactor(-a 1)、io_uring(-m 4,内核不支持时回退到epoll)
+static std::vector<std::string> mode_args(int mode) {
+    std::vector<std::string> args;
+    if (mode == 1) {
+        args.push_back("-a");
+        args.push_back("1");
+    } else if (mode == 2) {
+        args.push_back("-m");
+        args.push_back("4");
+    }
+    return args;
+}
+
+static const int MODES = 3;
+
+//一次发送的20个请求按顺序各得到一个完整的应答
+static void test_pipeline_batch() {
+    const char* paths[] = {"/judge.html", "/log.html", "/register.html", "/html.css"};
+    for (int mode = 0; mode < MODES; ++mode) {
+        int port = start_server(mode_args(mode));
+        http_stream s(connect_server(port));
+        std::string reqs;
+        for (int i = 0; i < 20; ++i) {
+            reqs += get_request(paths[i % 4]);
+        }
+        send_all(s.fd, reqs);
+        for (int i = 0; i < 20; ++i) {
+            http_response r;
+            CHECK(s.read(r));
+            CHECK(r.status == 200);
+            CHECK(r.body == read_file(paths[i % 4]));
+        }
+        CHECK(!s.closed());
+        stop_server();
+    }
+}
+
+//完整的请求之后跟着格式错误的请求:前一个应答照常发出,错误的请求得到错误应答后连接关闭
+static void test_pipeline_malformed() {
+    for (int mode = 0; mode < MODES; ++mode) {
+        int port = start_server(mode_args(mode));
+        http_stream s(connect_server(port));
+        //第二个请求的请求行只以\n结尾
+        send_all(s.fd, get_request("/judge.html") + "GET /log.html HTTP/1.1\nHost: localhost\r\n\r\n");
+        http_response r;
+        CHECK(s.read(r));
+        CHECK(r.status == 200);
+        CHECK(r.body == read_file("/judge.html"));
+        CHECK(s.read(r));
+        CHECK(r.status == 404);
+        CHECK(s.closed());
+        stop_server();
+    }
+}
+
+//Connection: close的请求之后的数据不再处理
+static void test_pipeline_close() {
+    for (int mode = 0; mode < MODES; ++mode) {
+        int port = start_server(mode_args(mode));
+        http_stream s(connect_server(port));
+        send_all(s.fd, get_request("/judge.html") + get_request("/log.html", "", false) + get_request("/html.css"));
+        http_response r;
+        CHECK(s.read(r) && r.status == 200 && r.body == read_file("/judge.html"));
+        CHECK(s.read(r) && r.status == 200 && r.body == read_file("/log.html"));
+        CHECK(s.closed());
+        stop_server();
+    }
+}
+
+//请求被拆成多次发送,包括逐字节发送
+static void test_pipeline_split() {
+    int port = start_server();
+    http_stream s(connect_server(port));
+    std::string data = get_request("/judge.html") + get_request("/log.html") + get_request("/html.css");
+    send_all(s.fd, data.substr(0, 30));
+    usleep(20 * 1000);
+    for (size_t i = 30; i < 90; ++i) {
+        send_all(s.fd, data.substr(i, 1));
+    }
+    send_all(s.fd, data.substr(90));
+    const char* paths[] = {"/judge.html", "/log.html", "/html.css"};
+    for (int i = 0; i < 3; ++i) {
+        http_response r;
+        CHECK(s.read(r) && r.status == 200 && r.body == read_file(paths[i]));
+    }
+}
+
+//应答缓存按连接状态各保存一份应答头:先由关闭连接的请求放入缓存,之后保持连接和关闭连接的请求都得到对应的应答头
+static void test_response_cache_connection_variants() {
+    for (int mode = 0; mode < MODES; mode += 2) {
+        int port = start_server(mode_args(mode));
+        std::string body = read_file("/judge.html");
+        http_response first;
+        {
+            http_stream s(connect_server(port));
+            send_all(s.fd, get_request("/judge.html", "", false));
+            CHECK(s.read(first) && first.status == 200 && first.body == body);
+            CHECK(strcmp(first.header("connection"), "close") == 0);
+            CHECK(s.closed());
+        }
+        http_stream s(connect_server(port));
+        for (int i = 0; i < 3; ++i) {
+            http_response r;
+            send_all(s.fd, get_request("/judge.html"));
+            CHECK(s.read(r) && r.status == 200 && r.body == body);
+            CHECK(strcmp(r.header("connection"), "keep-alive") == 0);
+            CHECK(strcmp(r.header("etag"), first.header("etag")) == 0);
+            CHECK(strcmp(r.header("content-type"), first.header("content-type")) == 0);
+        }
+        //除Connection外与第一次的应答头逐字节相同
+        http_response last;
+        send_all(s.fd, get_request("/judge.html", "", false));
+        CHECK(s.read(last) && last.status == 200 && last.body == body);
+        CHECK(last.head == first.head);
+        CHECK(s.closed());
+        stop_server();
+    }
+}
+
+//缓存的文件收到条件请求时仍按验证器应答304,不发送缓存的200应答
+static void test_response_cache_conditional() {
+    int port = start_server();
+    http_stream s(connect_server(port));
+    http_response r;
+    for (int i = 0; i < 2; ++i) {
+        send_all(s.fd, get_request("/judge.html"));
+        CHECK(s.read(r) && r.status == 200);
+    }
+    std::string etag = r.header("etag");
+    std::string last_modified = r.header("last-modified");
+
+    send_all(s.fd, get_request("/judge.html", "If-None-Match: " + etag + "\r\n"));
+    CHECK(s.read(r) && r.status == 304 && r.body.empty());
+    CHECK(etag == r.header("etag"));
+    send_all(s.fd, get_request("/judge.html", "If-Modified-Since: " + last_modified + "\r\n"));
+    CHECK(s.read(r) && r.status == 304);
+    //验证器不匹配时发送完整的应答
+    send_all(s.fd, get_request("/judge.html", "If-None-Match: \"other\"\r\n"));
+    CHECK(s.read(r) && r.status == 200 && r.body == read_file("/judge.html"));
+    //条件请求之后缓存的应答照常使用
+    send_all(s.fd, get_request("/judge.html"));
+    CHECK(s.read(r) && r.status == 200 && r.body == read_file("/judge.html"));
+}
+
+//缓存的文件收到Range请求时发送206和对应的片段
+static void test_response_cache_range() {
+    int port = start_server();
+    http_stream s(connect_server(port));
+    std::string body = read_file("/judge.html");
+    http_response r;
+    for (int i = 0; i < 2; ++i) {
+        send_all(s.fd, get_request("/judge.html"));
+        CHECK(s.read(r) && r.status == 200);
+    }
+    send_all(s.fd, get_request("/judge.html", "Range: bytes=0-9\r\n"));
+    CHECK(s.read(r) && r.status == 206);
+    CHECK(r.body == body.substr(0, 10));
+    char range[64];
+    snprintf(range, sizeof(range), "bytes 0-9/%d", (int)body.size());
+    CHECK(strcmp(r.header("content-range"), range) == 0);
+    send_all(s.fd, get_request("/judge.html", "Range: bytes=-5\r\n"));
+    CHECK(s.read(r) && r.status == 206 && r.body == body.substr(body.size() - 5));
+    send_all(s.fd, get_request("/judge.html", "Range: bytes=100000-\r\n"));
+    CHECK(s.read(r) && r.status == 416);
+    send_all(s.fd, get_request("/judge.html"));
+    CHECK(s.read(r) && r.status == 200 && r.body == body);
+}
+
+//解压gzip消息体
+static std::string gunzip(const std::string& data) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    CHECK(inflateInit2(&zs, 15 + 16) == Z_OK);
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = data.size();
+    std::string out;
+    char buf[16384];
+    int ret;
+    do {
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        CHECK(ret == Z_OK || ret == Z_STREAM_END);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret != Z_STREAM_END);
+    inflateEnd(&zs);
+    return out;
+}
+
+//反复请求直到得到指定编码的应答(后台压缩完成),最多等2秒
+static bool wait_encoding(http_stream& s, const char* path, const std::string& accept, const char* encoding, http_response& r) {
+    for (int i = 0; i < 100; ++i) {
+        send_all(s.fd, get_request(path, "Accept-Encoding: " + accept + "\r\n"));
+        CHECK(s.read(r) && r.status == 200);
+        if (r.header("content-encoding") && strcmp(r.header("content-encoding"), encoding) == 0) {
+            return true;
+        }
+        usleep(20 * 1000);
+    }
+    return false;
+}
+
+//文本文件先发送未压缩的版本,后台压缩完成后按Accept-Encoding发送压缩版本,解压后与原文件相同
+static void test_variant_gzip() {
+    int port = start_server();
+    http_stream s(connect_server(port));
+    std::string body = read_file("/judge.html");
+    http_response plain;
+    send_all(s.fd, get_request("/judge.html"));
+    CHECK(s.read(plain) && plain.status == 200 && plain.body == body);
+    CHECK(!plain.header("content-encoding"));
+    CHECK(strcmp(plain.header("vary"), "Accept-Encoding") == 0);
+
+    http_response r;
+    CHECK(wait_encoding(s, "/judge.html", "gzip, deflate", "gzip", r));
+    CHECK(r.body.size() < body.size());
+    CHECK(gunzip(r.body) == body);
+    CHECK(strcmp(r.header("vary"), "Accept-Encoding") == 0);
+    //压缩版本有自己的实体标签,条件请求按它判断
+    std::string etag = r.header("etag");
+    CHECK(etag != plain.header("etag"));
+    send_all(s.fd, get_request("/judge.html", "Accept-Encoding: gzip\r\nIf-None-Match: " + etag + "\r\n"));
+    CHECK(s.read(r) && r.status == 304);
+    send_all(s.fd, get_request("/judge.html", "If-None-Match: " + etag + "\r\n"));
+    CHECK(s.read(r) && r.status == 200 && r.body == body);
+
+    //不接受压缩或q=0时发送原文件
+    send_all(s.fd, get_request("/judge.html", "Accept-Encoding: gzip;q=0\r\n"));
+    CHECK(s.read(r) && r.status == 200 && !r.header("content-encoding") && r.body == body);
+    send_all(s.fd, get_request("/judge.html"));
+    CHECK(s.read(r) && r.status == 200 && !r.header("content-encoding") && r.body == body);
+}
+
+//图片等不可压缩的类型不带Vary,也不压缩
+static void test_variant_not_compressible() {
+    int port = start_server();
+    http_stream s(connect_server(port));
+    http_response r;
+    for (int i = 0; i < 3; ++i) {
+        send_all(s.fd, get_request("/favicon.ico", "Accept-Encoding: gzip\r\n"));
+        CHECK(s.read(r) && r.status == 200);
+        CHECK(!r.header("content-encoding") && !r.header("vary"));
+        CHECK(r.body == read_file("/favicon.ico"));
+        usleep(50 * 1000);
+    }
+}
+
+#ifdef HAVE_BROTLI
+//同时接受br和gzip时优先br
+static void test_variant_brotli() {
+    int port = start_server();
+    http_stream s(connect_server(port));
+    http_response r;
+    CHECK(wait_encoding(s, "/judge.html", "gzip, br", "br", r));
+    CHECK(r.body.size() < read_file("/judge.html").size());
+    send_all(s.fd, get_request("/judge.html", "Accept-Encoding: gzip, br;q=0\r\n"));
+    http_response g;
+    CHECK(s.read(g) && g.status == 200);
+    CHECK(!g.header("content-encoding") || strcmp(g.header("content-encoding"), "gzip") == 0);
+}
+#endif
+
+//按size字节一块编码成chunked消息体,块带扩展,最后一块之后带trailer
+static std::string chunked(const std::string& body, size_t size) {
+    std::string out;
+    char line[32];
+    for (size_t i = 0; i < body.size(); i += size) {
+        std::string piece = body.substr(i, size);
+        snprintf(line, sizeof(line), "%x;ext=1\r\n", (unsigned)piece.size());
+        out += line + piece + "\r\n";
+    }
+    return out + "0\r\nX-Trailer: y\r\n\r\n";
+}
+
+static std::string chunked_post(const char* path, const std::string& body, size_t size) {
+    return make_request("POST", path, "Transfer-Encoding: chunked\r\n") + chunked(body, size);
+}
+
+//注册一个用户,之后的登录请求可以成功
+static void sign_up(int port, const std::string& form) {
+    http_stream s(connect_server(port));
+    send_all(s.fd, make_request("POST", "/3CGISQL.cgi", "", true, form));
+    http_response r;
+    CHECK(s.read(r) && r.status == 200 && r.body == read_file("/log.html"));
+}
+
+//chunked消息体与Content-Length的消息体得到相同的处理结果,包括逐字节发送和流水线中的请求
+static void test_chunked_body() {
+    int port = start_server();
+    const std::string form = "user=abc&password=def";
+    sign_up(port, form);
+    std::string welcome = read_file("/welcome.html");
+    http_response r;
+    {
+        http_stream s(connect_server(port));
+        send_all(s.fd, chunked_post("/2CGISQL.cgi", form, 7));
+        CHECK(s.read(r) && r.status == 200 && r.body == welcome);
+    }
+    {
+        http_stream s(connect_server(port));
+        std::string data = chunked_post("/2CGISQL.cgi", form, 3);
+        for (size_t i = 0; i < data.size(); ++i) {
+            send_all(s.fd, data.substr(i, 1));
+        }
+        CHECK(s.read(r) && r.status == 200 && r.body == welcome);
+    }
+    {
+        http_stream s(connect_server(port));
+        send_all(s.fd, chunked_post("/2CGISQL.cgi", form, 5)
+                       + make_request("POST", "/2CGISQL.cgi", "", true, "user=abc&password=x") + get_request("/judge.html"));
+        CHECK(s.read(r) && r.status == 200 && r.body == welcome);
+        CHECK(s.read(r) && r.status == 200 && r.body == read_file("/logError.html"));
+        CHECK(s.read(r) && r.status == 200 && r.body == read_file("/judge.html"));
+    }
+}
+
+//服务器打开的文件中已删除的临时文件个数
+static int spooled_files() {
+    char dir[64];
+    snprintf(dir, sizeof(dir), "/proc/%d/fd", (int)g_server_pid);
+    int count = 0;
+    for (int fd = 0; fd < 1024; ++fd) {
+        char path[96], target[256];
+        snprintf(path, sizeof(path), "%s/%d", dir, fd);
+        ssize_t n = readlink(path, target, sizeof(target) - 1);
+        if (n <= 0) {
+            continue;
+        }
+        target[n] = '\0';
+        count += strncmp(target, P_tmpdir, strlen(P_tmpdir)) == 0 && strstr(target, "(deleted)") != NULL;
+    }
+    return count;
+}
+
+//超过BODY_MEMORY_SIZE的消息体边收边写入临时文件,处理完后关闭;消息体内容与小的消息体一样可以读到
+static void test_large_body_spooled() {
+    int port = start_server();
+    //表单中的密码最多读取99个字符
+    std::string password(99, 'z');
+    sign_up(port, "user=big&password=" + password);
+    std::string big = "user=big&password=" + std::string(4 << 20, 'z');
+    for (int chunk = 0; chunk < 2; ++chunk) {
+        http_stream s(connect_server(port));
+        std::string data = chunk ? chunked_post("/2CGISQL.cgi", big, 100000)
+                                 : make_request("POST", "/2CGISQL.cgi", "", true, big);
+        size_t half = data.size() / 2;
+        send_all(s.fd, data.substr(0, half));
+        //服务器收到一半时消息体已经在临时文件中
+        int spooled = 0;
+        for (int i = 0; i < 100 && spooled == 0; ++i) {
+            usleep(10 * 1000);
+            spooled = spooled_files();
+        }
+        CHECK(spooled == 1);
+        send_all(s.fd, data.substr(half));
+        http_response r;
+        CHECK(s.read(r) && r.status == 200 && r.body == read_file("/welcome.html"));
+        CHECK(spooled_files() == 0);
+    }
+}
+
+//格式错误的chunked消息体、不支持的Transfer-Encoding和过大的Content-Length按错误请求处理
+static void test_bad_body() {
+    int port = start_server();
+    const char* bad[] = {
+        "POST /2CGISQL.cgi HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+        "POST /2CGISQL.cgi HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+        "POST /2CGISQL.cgi HTTP/1.1\r\nContent-Length: 104857600\r\n\r\n",
+    };
+    for (int i = 0; i < 3; ++i) {
+        http_stream s(connect_server(port));
+        send_all(s.fd, bad[i]);
+        http_response r;
+        CHECK(s.read(r) && r.status == 404);
+        CHECK(s.closed());
+    }
+}
+
+int main() {
+    static const test_case cases[] = {
+        {"pipeline_batch", test_pipeline_batch},
+        {"pipeline_malformed", test_pipeline_malformed},
+        {"pipeline_close", test_pipeline_close},
+        {"pipeline_split", test_pipeline_split},
+        {"response_cache_connection_variants", test_response_cache_connection_variants},
+        {"response_cache_conditional", test_response_cache_conditional},
+        {"response_cache_range", test_response_cache_range},
+        {"variant_gzip", test_variant_gzip},
+        {"variant_not_compressible", test_variant_not_compressible},
+#ifdef HAVE_BROTLI
+        {"variant_brotli", test_variant_brotli},
+#endif
+        {"chunked_body", test_chunked_body},
+        {"large_body_spooled", test_large_body_spooled},
+        {"bad_body", test_bad_body},
+    };
+    return run_tests(cases, sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,7 @@
+#ifndef TEST_STUB_ERRMSG_H
+#define TEST_STUB_ERRMSG_H
+
+#define CR_SERVER_GONE_ERROR 2006
+#define CR_SERVER_LOST 2013
+
+#endif
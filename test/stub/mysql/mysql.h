@@ -0,0 +1,57 @@
+#ifndef TEST_STUB_MYSQL_H
+#define TEST_STUB_MYSQL_H
+
+//测试用的MySQL客户端库头文件,只声明服务器用到的类型和函数,实现见mysql_stub.cpp
+//测试目标用-I./test/stub让它代替系统的<mysql/mysql.h>,不需要安装MySQL
+
+#include <stddef.h>
+
+typedef struct st_mysql MYSQL;
+typedef struct st_mysql_res MYSQL_RES;
+typedef struct st_mysql_stmt MYSQL_STMT;
+typedef char** MYSQL_ROW;
+
+typedef struct st_mysql_field {
+    char* name;
+} MYSQL_FIELD;
+
+enum enum_field_types {
+    MYSQL_TYPE_STRING = 254
+};
+
+enum mysql_option {
+    MYSQL_OPT_CONNECT_TIMEOUT = 0
+};
+
+typedef struct st_mysql_bind {
+    unsigned long* length;
+    bool* is_null;
+    void* buffer;
+    unsigned long buffer_length;
+    enum enum_field_types buffer_type;
+} MYSQL_BIND;
+
+extern "C" {
+MYSQL* mysql_init(MYSQL* mysql);
+int mysql_options(MYSQL* mysql, enum mysql_option option, const void* arg);
+MYSQL* mysql_real_connect(MYSQL* mysql, const char* host, const char* user, const char* passwd, const char* db,
+                          unsigned int port, const char* unix_socket, unsigned long clientflag);
+void mysql_close(MYSQL* mysql);
+int mysql_ping(MYSQL* mysql);
+unsigned int mysql_errno(MYSQL* mysql);
+const char* mysql_error(MYSQL* mysql);
+int mysql_query(MYSQL* mysql, const char* q);
+MYSQL_RES* mysql_store_result(MYSQL* mysql);
+unsigned int mysql_num_fields(MYSQL_RES* res);
+MYSQL_FIELD* mysql_fetch_field(MYSQL_RES* res);
+MYSQL_ROW mysql_fetch_row(MYSQL_RES* res);
+void mysql_free_result(MYSQL_RES* res);
+MYSQL_STMT* mysql_stmt_init(MYSQL* mysql);
+int mysql_stmt_prepare(MYSQL_STMT* stmt, const char* query, unsigned long length);
+bool mysql_stmt_bind_param(MYSQL_STMT* stmt, MYSQL_BIND* bnd);
+int mysql_stmt_execute(MYSQL_STMT* stmt);
+const char* mysql_stmt_error(MYSQL_STMT* stmt);
+bool mysql_stmt_close(MYSQL_STMT* stmt);
+}
+
+#endif
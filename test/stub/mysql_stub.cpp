@@ -0,0 +1,276 @@
+#include <string.h>
+#include <pthread.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mysql_stub.h"
+#include "mysql/errmsg.h"
+
+struct st_mysql {
+    int generation;         //建立时数据库的代数,restart之后不再可用
+    bool connected;
+    unsigned int err;
+    const char* error;
+    std::set<st_mysql_stmt*> stmts;
+};
+
+struct st_mysql_stmt {
+    MYSQL* mysql;           //连接关闭后为NULL
+    std::string sql;
+    int params;
+    MYSQL_BIND* bind;
+    const char* error;
+};
+
+struct st_mysql_res {
+    std::vector<std::pair<std::string, std::string> > rows;
+    size_t next;
+    char* row[2];
+    MYSQL_FIELD fields[2];
+};
+
+namespace {
+    pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+    bool g_down = false;
+    bool g_fail_writes = false;
+    int g_generation = 0;
+    int g_connects = 0;
+    int g_closes = 0;
+    int g_pings = 0;
+    int g_prepares = 0;
+    int g_executes = 0;
+    int g_open_connections = 0;
+    int g_open_statements = 0;
+    std::map<std::string, std::string> g_users;
+
+    const char* GONE = "MySQL server has gone away";
+    const char* LOST = "Lost connection to MySQL server during query";
+
+    struct guard {
+        guard() { pthread_mutex_lock(&g_lock); }
+        ~guard() { pthread_mutex_unlock(&g_lock); }
+    };
+
+    //调用时持有g_lock
+    bool alive(MYSQL* m) {
+        return m->connected && m->generation == g_generation && !g_down;
+    }
+
+    void set_error(MYSQL* m, unsigned int err, const char* error) {
+        m->err = err;
+        m->error = error;
+    }
+}
+
+namespace mysql_stub {
+    void set_down(bool down) { guard g; g_down = down; }
+    void restart() { guard g; ++g_generation; }
+    void lose(MYSQL* con) { guard g; con->generation = -1; set_error(con, CR_SERVER_LOST, LOST); }
+    void set_fail_writes(bool fail) { guard g; g_fail_writes = fail; }
+    int connects() { guard g; return g_connects; }
+    int closes() { guard g; return g_closes; }
+    int pings() { guard g; return g_pings; }
+    int prepares() { guard g; return g_prepares; }
+    int executes() { guard g; return g_executes; }
+    int open_connections() { guard g; return g_open_connections; }
+    int open_statements() { guard g; return g_open_statements; }
+    bool has_user(const std::string& name) { guard g; return g_users.count(name) != 0; }
+}
+
+extern "C" {
+
+MYSQL* mysql_init(MYSQL* mysql) {
+    if (mysql) {
+        return mysql;
+    }
+    MYSQL* m = new st_mysql;
+    m->generation = 0;
+    m->connected = false;
+    set_error(m, 0, "");
+    return m;
+}
+
+int mysql_options(MYSQL*, enum mysql_option, const void*) {
+    return 0;
+}
+
+MYSQL* mysql_real_connect(MYSQL* mysql, const char*, const char*, const char*, const char*, unsigned int, const char*,
+                          unsigned long) {
+    guard g;
+    if (g_down) {
+        set_error(mysql, 2003, "Can't connect to MySQL server");
+        return NULL;
+    }
+    mysql->generation = g_generation;
+    mysql->connected = true;
+    set_error(mysql, 0, "");
+    ++g_connects;
+    ++g_open_connections;
+    return mysql;
+}
+
+void mysql_close(MYSQL* mysql) {
+    if (!mysql) {
+        return;
+    }
+    guard g;
+    for (std::set<st_mysql_stmt*>::iterator it = mysql->stmts.begin(); it != mysql->stmts.end(); ++it) {
+        (*it)->mysql = NULL;
+    }
+    if (mysql->connected) {
+        ++g_closes;
+        --g_open_connections;
+    }
+    delete mysql;
+}
+
+int mysql_ping(MYSQL* mysql) {
+    guard g;
+    ++g_pings;
+    if (!alive(mysql)) {
+        set_error(mysql, CR_SERVER_GONE_ERROR, GONE);
+        return 1;
+    }
+    set_error(mysql, 0, "");
+    return 0;
+}
+
+unsigned int mysql_errno(MYSQL* mysql) {
+    return mysql->err;
+}
+
+const char* mysql_error(MYSQL* mysql) {
+    return mysql->error;
+}
+
+//只支持读入用户表的SELECT,其他语句直接成功
+int mysql_query(MYSQL* mysql, const char*) {
+    guard g;
+    if (!alive(mysql)) {
+        set_error(mysql, CR_SERVER_GONE_ERROR, GONE);
+        return 1;
+    }
+    set_error(mysql, 0, "");
+    return 0;
+}
+
+MYSQL_RES* mysql_store_result(MYSQL*) {
+    guard g;
+    MYSQL_RES* res = new st_mysql_res;
+    res->rows.assign(g_users.begin(), g_users.end());
+    res->next = 0;
+    res->fields[0].name = (char*)"username";
+    res->fields[1].name = (char*)"passwd";
+    return res;
+}
+
+unsigned int mysql_num_fields(MYSQL_RES*) {
+    return 2;
+}
+
+MYSQL_FIELD* mysql_fetch_field(MYSQL_RES* res) {
+    return res->fields;
+}
+
+MYSQL_ROW mysql_fetch_row(MYSQL_RES* res) {
+    if (res->next >= res->rows.size()) {
+        return NULL;
+    }
+    res->row[0] = (char*)res->rows[res->next].first.c_str();
+    res->row[1] = (char*)res->rows[res->next].second.c_str();
+    ++res->next;
+    return res->row;
+}
+
+void mysql_free_result(MYSQL_RES* res) {
+    delete res;
+}
+
+MYSQL_STMT* mysql_stmt_init(MYSQL* mysql) {
+    guard g;
+    MYSQL_STMT* stmt = new st_mysql_stmt;
+    stmt->mysql = mysql;
+    stmt->params = 0;
+    stmt->bind = NULL;
+    stmt->error = "";
+    mysql->stmts.insert(stmt);
+    ++g_open_statements;
+    return stmt;
+}
+
+//调用时持有g_lock,连接不可用时设置错误并返回false
+static bool stmt_usable(MYSQL_STMT* stmt) {
+    if (!stmt->mysql) {
+        stmt->error = LOST;
+        return false;
+    }
+    if (!alive(stmt->mysql)) {
+        if (stmt->mysql->err != CR_SERVER_LOST) {
+            set_error(stmt->mysql, CR_SERVER_GONE_ERROR, GONE);
+        }
+        stmt->error = stmt->mysql->error;
+        return false;
+    }
+    return true;
+}
+
+int mysql_stmt_prepare(MYSQL_STMT* stmt, const char* query, unsigned long length) {
+    guard g;
+    if (!stmt_usable(stmt)) {
+        return 1;
+    }
+    ++g_prepares;
+    stmt->sql.assign(query, length);
+    stmt->params = 0;
+    for (unsigned long i = 0; i < length; ++i) {
+        stmt->params += query[i] == '?';
+    }
+    return 0;
+}
+
+bool mysql_stmt_bind_param(MYSQL_STMT* stmt, MYSQL_BIND* bnd) {
+    stmt->bind = bnd;
+    return false;
+}
+
+//INSERT的参数依次是各行的用户名和密码,已有的用户名被忽略,与INSERT IGNORE一致
+int mysql_stmt_execute(MYSQL_STMT* stmt) {
+    guard g;
+    if (!stmt_usable(stmt)) {
+        return 1;
+    }
+    bool insert = stmt->sql.compare(0, 6, "INSERT") == 0;
+    if (insert && g_fail_writes) {
+        stmt->error = "Lock wait timeout exceeded";
+        return 1;
+    }
+    ++g_executes;
+    if (insert) {
+        for (int i = 0; i + 1 < stmt->params; i += 2) {
+            MYSQL_BIND* b = stmt->bind + i;
+            std::string name((const char*)b[0].buffer, *b[0].length);
+            std::string password((const char*)b[1].buffer, *b[1].length);
+            g_users.insert(std::make_pair(name, password));
+        }
+    }
+    stmt->error = "";
+    return 0;
+}
+
+const char* mysql_stmt_error(MYSQL_STMT* stmt) {
+    return stmt->error;
+}
+
+bool mysql_stmt_close(MYSQL_STMT* stmt) {
+    guard g;
+    if (stmt->mysql) {
+        stmt->mysql->stmts.erase(stmt);
+    }
+    --g_open_statements;
+    delete stmt;
+    return false;
+}
+
+}
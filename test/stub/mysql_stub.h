@@ -0,0 +1,30 @@
+#ifndef MYSQL_STUB_H
+#define MYSQL_STUB_H
+
+#include <string>
+#include <mysql/mysql.h>
+
+//测试用的MySQL客户端库替身:不连接服务器,连接、语句和user表都在进程内模拟,测试通过这里的函数控制和观察它
+//与真实的客户端库一致:关闭连接时其上的语句被摘下,之后执行这些语句报告CR_SERVER_LOST
+namespace mysql_stub {
+    //数据库不可用:建立连接失败,已建立的连接上的操作报告CR_SERVER_GONE_ERROR
+    void set_down(bool down);
+    //模拟数据库重启:已建立的连接全部失效,之后新建的连接可用
+    void restart();
+    //连接con断开,它上面的下一次操作报告CR_SERVER_LOST
+    void lose(MYSQL* con);
+    //INSERT执行失败(连接本身正常)
+    void set_fail_writes(bool fail);
+
+    int connects();         //建立成功的连接数
+    int closes();           //关闭的连接数
+    int pings();
+    int prepares();
+    int executes();
+    int open_connections();
+    int open_statements();
+    //user表中是否有该用户
+    bool has_user(const std::string& name);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <stdint.h>
+
+//测试的公共部分:每个用例在fork出的子进程中运行,单例(连接池、缓存等)在用例之间互不影响
+//CHECK失败时打印位置并让该用例的子进程以1退出,其余用例照常运行
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                 \
+        }                                                                            \
+    } while (0)
+
+struct test_case {
+    const char* name;
+    void (*run)();
+};
+
+//单调时钟,毫秒
+static inline int64_t test_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//依次运行各用例,全部通过时返回0
+static inline int run_tests(const test_case* cases, int n) {
+    int failed = 0;
+    for (int i = 0; i < n; ++i) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            cases[i].run();
+            exit(0);
+        }
+        int status = 1;
+        waitpid(pid, &status, 0);
+        bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        printf("%-40s %s\n", cases[i].name, ok ? "ok" : "FAILED");
+        failed += !ok;
+    }
+    printf("%d of %d passed\n", n - failed, n);
+    return failed ? 1 : 0;
+}
+
+#endif
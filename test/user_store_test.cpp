@@ -0,0 +1,195 @@
+#include "test.h"
+#include "../CGImysql/user_store.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+
+//用户表的测试:每个用例在新的子进程中运行,单例从空表开始
+//并发用例中读线程不加锁查询,写线程插入时触发扩容、删除时留下删除标记
+
+static void user_name(char* buf, int writer, int i) {
+    sprintf(buf, "u%d_%d", writer, i);
+}
+
+//重复插入不修改密码,删除后可以用新密码重新插入
+static void test_insert_check_erase() {
+    user_store* users = user_store::get_instance();
+    CHECK(users->size() == 0);
+    CHECK(!users->contains("alice"));
+    CHECK(users->insert("alice", "a1"));
+    CHECK(!users->insert("alice", "a2"));
+    CHECK(users->check("alice", "a1"));
+    CHECK(!users->check("alice", "a2"));
+    CHECK(!users->check("alice", "a"));
+    CHECK(!users->check("alic", "a1"));
+    CHECK(!users->check("alicee", "a1"));
+    CHECK(users->insert("", ""));
+    CHECK(users->check("", ""));
+    CHECK(users->size() == 2);
+
+    CHECK(users->erase("alice"));
+    CHECK(!users->erase("alice"));
+    CHECK(!users->contains("alice"));
+    CHECK(users->size() == 1);
+    CHECK(users->insert("alice", "a2"));
+    CHECK(users->check("alice", "a2"));
+    CHECK(users->size() == 2);
+}
+
+//插入远多于初始槽数的用户,每个分片扩容多次后全部可以查到
+static void test_growth() {
+    user_store* users = user_store::get_instance();
+    const int COUNT = 200000;
+    char name[32], password[32];
+    for (int i = 0; i < COUNT; ++i) {
+        user_name(name, 0, i);
+        sprintf(password, "p%d", i);
+        CHECK(users->insert(name, password));
+    }
+    CHECK(users->size() == (size_t)COUNT);
+    for (int i = 0; i < COUNT; ++i) {
+        user_name(name, 0, i);
+        sprintf(password, "p%d", i);
+        CHECK(users->check(name, password));
+        user_name(name, 1, i);
+        CHECK(!users->contains(name));
+    }
+}
+
+//反复删除和重新插入:删除标记不截断其他用户的探测路径,插入复用删除标记,槽不会被标记占满
+static void test_tombstones() {
+    user_store* users = user_store::get_instance();
+    const int COUNT = 5000;
+    char name[32];
+    for (int i = 0; i < COUNT; ++i) {
+        user_name(name, 0, i);
+        CHECK(users->insert(name, "keep"));
+    }
+    for (int round = 0; round < 50; ++round) {
+        for (int i = 0; i < COUNT; ++i) {
+            user_name(name, 1, round * COUNT + i);
+            CHECK(users->insert(name, "tmp"));
+        }
+        for (int i = 0; i < COUNT; ++i) {
+            user_name(name, 1, round * COUNT + i);
+            CHECK(users->erase(name));
+        }
+        for (int i = round; i < COUNT; i += 50) {
+            user_name(name, 0, i);
+            CHECK(users->check(name, "keep"));
+        }
+    }
+    CHECK(users->size() == (size_t)COUNT);
+    for (int i = 0; i < COUNT; ++i) {
+        user_name(name, 0, i);
+        CHECK(users->check(name, "keep"));
+        user_name(name, 1, i);
+        CHECK(!users->contains(name));
+    }
+}
+
+static const int WRITERS = 4;
+static const int READERS = 4;
+static const int PER_WRITER = 50000;
+static std::atomic<int> g_progress[WRITERS];    //每个写线程已经插入的用户数
+static std::atomic<bool> g_done;
+static std::atomic<long> g_inserted;
+
+static void* writer_thread(void* arg) {
+    int id = (int)(long)arg;
+    user_store* users = user_store::get_instance();
+    char name[32];
+    for (int i = 0; i < PER_WRITER; ++i) {
+        user_name(name, id, i);
+        CHECK(users->insert(name, name));
+        g_progress[id].store(i + 1, std::memory_order_release);
+        //每插入一个用户就插入并删除一个临时用户,让读线程遇到删除标记
+        user_name(name, id + WRITERS, i);
+        CHECK(users->insert(name, "tmp"));
+        CHECK(users->erase(name));
+    }
+    return NULL;
+}
+
+//已经插入的用户无论分片是否在扩容都必须能查到,密码完整
+static void* reader_thread(void* arg) {
+    unsigned seed = (unsigned)(long)arg;
+    user_store* users = user_store::get_instance();
+    char name[32];
+    while (!g_done.load(std::memory_order_acquire)) {
+        int id = rand_r(&seed) % WRITERS;
+        int done = g_progress[id].load(std::memory_order_acquire);
+        if (done == 0) {
+            continue;
+        }
+        user_name(name, id, rand_r(&seed) % done);
+        CHECK(users->check(name, name));
+    }
+    return NULL;
+}
+
+static void test_concurrent() {
+    pthread_t writers[WRITERS], readers[READERS];
+    for (long i = 0; i < READERS; ++i) {
+        CHECK(pthread_create(&readers[i], NULL, reader_thread, (void*)(i + 1)) == 0);
+    }
+    for (long i = 0; i < WRITERS; ++i) {
+        CHECK(pthread_create(&writers[i], NULL, writer_thread, (void*)i) == 0);
+    }
+    for (int i = 0; i < WRITERS; ++i) {
+        pthread_join(writers[i], NULL);
+    }
+    g_done.store(true, std::memory_order_release);
+    for (int i = 0; i < READERS; ++i) {
+        pthread_join(readers[i], NULL);
+    }
+    user_store* users = user_store::get_instance();
+    CHECK(users->size() == (size_t)WRITERS * PER_WRITER);
+    char name[32];
+    for (int id = 0; id < WRITERS; ++id) {
+        for (int i = 0; i < PER_WRITER; ++i) {
+            user_name(name, id, i);
+            CHECK(users->check(name, name));
+            user_name(name, id + WRITERS, i);
+            CHECK(!users->contains(name));
+        }
+    }
+}
+
+//所有线程插入同一组用户名,每个用户名只有一次插入成功
+static void* duplicate_thread(void*) {
+    user_store* users = user_store::get_instance();
+    char name[32];
+    for (int i = 0; i < PER_WRITER; ++i) {
+        user_name(name, 0, i);
+        if (users->insert(name, "same")) {
+            g_inserted.fetch_add(1);
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent_duplicates() {
+    pthread_t threads[WRITERS];
+    for (int i = 0; i < WRITERS; ++i) {
+        CHECK(pthread_create(&threads[i], NULL, duplicate_thread, NULL) == 0);
+    }
+    for (int i = 0; i < WRITERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    CHECK(g_inserted.load() == PER_WRITER);
+    CHECK(user_store::get_instance()->size() == (size_t)PER_WRITER);
+}
+
+int main() {
+    static const test_case cases[] = {
+        {"insert_check_erase", test_insert_check_erase},
+        {"growth", test_growth},
+        {"tombstones", test_tombstones},
+        {"concurrent", test_concurrent},
+        {"concurrent_duplicates", test_concurrent_duplicates},
+    };
+    return run_tests(cases, sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,96 @@
+#include "test.h"
+#include "stub/mysql_stub.h"
+#include "../CGImysql/sql_connection_pool.h"
+#include "../CGImysql/user_writer.h"
+
+//注册后台写入的测试,数据库由test/stub中的替身模拟
+//连接池的最长空闲时间缩短为200ms,后台线程的专用连接按它关闭
+
+static const int MAX_IDLE_MS = 200;
+
+static user_writer* make_writer(int ack_mode) {
+    connection_pool* pool = connection_pool::GetInstance();
+    pool->SetTimeouts(200, 100, MAX_IDLE_MS);
+    pool->init("localhost", "root", "root", "db", 3306, 1, 2, 1);
+    user_writer* writer = user_writer::get_instance();
+    writer->init(pool, ack_mode, 1);
+    return writer;
+}
+
+//ACK_COMMITTED时返回前已经写入数据库
+static void test_committed() {
+    user_writer* writer = make_writer(user_writer::ACK_COMMITTED);
+    CHECK(writer->submit("alice", "a"));
+    CHECK(mysql_stub::has_user("alice"));
+    //专用连接不占用池中的连接
+    CHECK(connection_pool::GetInstance()->GetStats().acquired == 0);
+    writer->stop();
+}
+
+//一批按行数的二进制位拆开执行,每种行数的语句只预处理一次
+static void test_batch_split() {
+    user_writer* writer = make_writer(user_writer::ACK_QUEUED);
+    char name[16];
+    for (int i = 0; i < 300; ++i) {
+        snprintf(name, sizeof(name), "user%d", i);
+        CHECK(writer->submit(name, "p"));
+    }
+    writer->stop();
+    for (int i = 0; i < 300; ++i) {
+        snprintf(name, sizeof(name), "user%d", i);
+        CHECK(mysql_stub::has_user(name));
+    }
+    CHECK(mysql_stub::prepares() <= user_writer::INSERT_SIZES);
+}
+
+//写入失败时重试,最终失败的注册返回失败
+static void test_failed_write() {
+    mysql_stub::set_fail_writes(true);
+    user_writer* writer = make_writer(user_writer::ACK_COMMITTED);
+    CHECK(!writer->submit("bob", "b"));
+    CHECK(!mysql_stub::has_user("bob"));
+    mysql_stub::set_fail_writes(false);
+    CHECK(writer->submit("carol", "c"));
+    CHECK(mysql_stub::has_user("carol"));
+    writer->stop();
+}
+
+//数据库重启后重新连接,在新连接上重新预处理后写入
+static void test_reconnect() {
+    user_writer* writer = make_writer(user_writer::ACK_COMMITTED);
+    CHECK(writer->submit("dave", "d"));
+    int prepares = mysql_stub::prepares();
+    mysql_stub::restart();
+    CHECK(writer->submit("erin", "e"));
+    CHECK(mysql_stub::has_user("erin"));
+    CHECK(mysql_stub::prepares() == prepares + 1);
+    writer->stop();
+}
+
+//专用连接空闲超过最长空闲时间后关闭,有新用户时重新连接;停止时关闭
+static void test_idle_connection_closed() {
+    user_writer* writer = make_writer(user_writer::ACK_COMMITTED);
+    int pool_conns = mysql_stub::open_connections();
+    CHECK(writer->submit("frank", "f"));
+    CHECK(mysql_stub::open_connections() == pool_conns + 1);
+    usleep((MAX_IDLE_MS + 100) * 1000);
+    CHECK(mysql_stub::open_connections() == pool_conns);
+    CHECK(mysql_stub::open_statements() == 0);
+    CHECK(writer->submit("grace", "g"));
+    CHECK(mysql_stub::has_user("grace"));
+    CHECK(mysql_stub::open_connections() == pool_conns + 1);
+    writer->stop();
+    CHECK(mysql_stub::open_connections() == pool_conns);
+    CHECK(mysql_stub::open_statements() == 0);
+}
+
+int main() {
+    static const test_case cases[] = {
+        {"committed", test_committed},
+        {"batch_split", test_batch_split},
+        {"failed_write", test_failed_write},
+        {"reconnect", test_reconnect},
+        {"idle_connection_closed", test_idle_connection_closed},
+    };
+    return run_tests(cases, sizeof(cases) / sizeof(cases[0]));
+}
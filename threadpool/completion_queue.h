@@ -0,0 +1,64 @@
+#ifndef COMPLETION_QUEUE_H
+#define COMPLETION_QUEUE_H
+
+#include <list>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <exception>
+#include "../lock/locker.h"
+
+//完成队列:reactor模式下工作线程处理完读写任务后,把请求放入其所属反应堆的完成队列并写eventfd,
+//反应堆在epoll_wait中收到可读事件后统一回收,不必再忙等工作线程
+template <typename T>
+class completion_queue
+{
+public:
+    completion_queue();
+    ~completion_queue();
+
+    //注册到反应堆epoll上的eventfd
+    int fd() const { return m_evfd; }
+    //工作线程调用:投递一个已完成的请求并唤醒反应堆
+    void push(T* request);
+    //反应堆线程调用:取走当前全部已完成的请求
+    void drain(std::list<T*>& done);
+
+private:
+    int m_evfd;
+    locker m_lock;          //保护m_done
+    std::list<T*> m_done;
+};
+
+template <typename T>
+completion_queue<T>::completion_queue() {
+    m_evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_evfd == -1) {
+        throw std::exception();
+    }
+}
+
+template <typename T>
+completion_queue<T>::~completion_queue() {
+    close(m_evfd);
+}
+
+template <typename T>
+void completion_queue<T>::push(T* request) {
+    m_lock.lock();
+    m_done.push_back(request);
+    m_lock.unlock();
+    uint64_t one = 1;
+    ::write(m_evfd, &one, sizeof(one));
+}
+
+template <typename T>
+void completion_queue<T>::drain(std::list<T*>& done) {
+    uint64_t cnt;
+    ::read(m_evfd, &cnt, sizeof(cnt));
+    m_lock.lock();
+    done.splice(done.end(), m_done);
+    m_lock.unlock();
+}
+
+#endif
@@ -6,7 +6,6 @@
 #include <pthread.h>
 #include <exception>
 #include "../lock/locker.h"
-#include "../CGImysql/sql_connection_pool.h"
 
 
 template <typename T>
@@ -18,7 +17,7 @@ private:
     void run();
 public:
     //thread_number是线程池中线程的数量(本机为四核处理器)，max_requests是请求队列中最多允许的、等待处理的请求的数量
-    threadpool(int actor_model, connection_pool *connPool, int thread_number = 8, int max_request = 10000);
+    threadpool(int actor_model, int thread_number = 8, int max_request = 10000);
     ~threadpool();
     bool append(T* request, int state);  //往请求队列添加任务
     bool append_p(T* request);
@@ -31,12 +30,11 @@ private:
     locker m_queuelocker;       //互斥锁:保护请求队列
     sem m_queuestat;            //信号量:用来确定是否有任务需要处理
     int m_actor_model;          //模型切换
-    connection_pool* m_connPool;    //数据库
 
 };
 
 template<typename T>
-threadpool<T>::threadpool(int actor_model, connection_pool* connPool, int thread_number, int max_requests) : m_actor_model(actor_model),m_thread_number(thread_number), m_max_requests(max_requests), m_threads(NULL),m_connPool(connPool)
+threadpool<T>::threadpool(int actor_model, int thread_number, int max_requests) : m_actor_model(actor_model),m_thread_number(thread_number), m_max_requests(max_requests), m_threads(NULL)
 {
     if (thread_number <= 0 || max_requests <= 0) {
         throw std::exception();
@@ -121,35 +119,37 @@ void threadpool<T>::run() {
         {
             if (0 == request->m_state)
             {
-                if (request->read_once())
+                if (!request->read_once() || !request->process())
                 {
-                    request->improv = 1;
-                    connectionRAII mysqlcon(&request->mysql, m_connPool);       //数据库连接池取和归还
-                    request->process();
-                }
-                else
-                {
-                    request->improv = 1;
                     request->timer_flag = 1;
                 }
             }
             else
             {
-                if (request->write())
+                bool pending = false;
+                if (!request->write(&pending))
                 {
-                    request->improv = 1;
+                    request->timer_flag = 1;
                 }
-                else
+                else if (pending && !request->process())
                 {
-                    request->improv = 1;
+                    //流水线中的下一个请求已在读缓冲区中,直接处理
                     request->timer_flag = 1;
                 }
             }
+            //每次派发只投递一次完成项,由反应堆线程处理timer_flag
+            request->m_cq->push(request);
         }
         else
         {
-            connectionRAII mysqlcon(&request->mysql, m_connPool);
-            request->process();              //  process(模板类中的方法,这里是http类)进行处理
+            //  process(模板类中的方法,这里是http类)进行处理
+            //成功时process已重新注册事件,连接可能已被反应堆线程接手,之后不能再访问request
+            //失败时交回所属反应堆线程关闭连接,工作线程直接关闭会与定时器和连接表的回收冲突
+            if (!request->process())
+            {
+                request->timer_flag = 1;
+                request->m_cq->push(request);
+            }
         }
         
     }
@@ -1,149 +1,177 @@
 #include "lst_timer.h"
 #include "../http/http_conn.h"
+#include "../http/conn_table.h"
 
-sort_timer_lst::sort_timer_lst() {
-    head = NULL;
-    tail = NULL;
+uint64_t current_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-//链表被销毁时，删除其中所有的定时器
-sort_timer_lst::~sort_timer_lst() {
-    util_timer* tmp = head;
-    while (tmp) {
-        head = head->next;
-        delete tmp;
-        tmp = head;
+time_wheel::time_wheel() {
+    m_jiffies = current_ms();
+    m_count = 0;
+    for (int i = 0; i < TVR_SIZE; ++i) {
+        list_init(&m_tv1[i]);
+    }
+    for (int l = 0; l < LEVELS; ++l) {
+        for (int i = 0; i < TVN_SIZE; ++i) {
+            list_init(&m_tvn[l][i]);
+        }
     }
 }
 
-//将目标定时器timer添加到链表中,内部调用私有成员add_timer
-void sort_timer_lst::add_timer(util_timer* timer) {
-    if (!timer) {
-        return;
-    }
-    if (!head) {
-        head = tail = timer;
-        return;
+//定时器结点嵌入在client_data中，由其所有者释放，这里只需要把它们从槽位上摘下
+time_wheel::~time_wheel() {
+    for (int i = 0; i < TVR_SIZE; ++i) {
+        while (m_tv1[i].next != &m_tv1[i]) {
+            list_del(m_tv1[i].next);
+        }
     }
-    //如果新的定时器超时时间小于当前头部结点
-    //直接将当前定时器结点作为头部结点
-    if (timer->expire < head->expire) {
-        timer->next = head;
-        head->prev = timer;
-        head = timer;
-        return;
+    for (int l = 0; l < LEVELS; ++l) {
+        for (int i = 0; i < TVN_SIZE; ++i) {
+            while (m_tvn[l][i].next != &m_tvn[l][i]) {
+                list_del(m_tvn[l][i].next);
+            }
+        }
     }
-    //否则调用私有成员，调整内部结点
-    add_timer(timer, head);
 }
 
-/*调整定时器，任务发生变化时，调整定时器在链表中的位置, 这个函数只考虑被调整的定时器的
-超时时间延长的情况， 即该定时器需要往链表的尾部移动*/
-void sort_timer_lst::adjust_timer(util_timer* timer) {
-    if (!timer) {
-        return;
-    }
-    util_timer* tmp = timer->next;
-    
-    //被调整的定时器在链表尾部
-    //定时器超时值仍然小于下一个定时器超时值，不调整
-    if (!tmp || (timer->expire < tmp->expire)) {
-        return;
+void time_wheel::list_init(util_timer* head) {
+    head->prev = head;
+    head->next = head;
+}
+
+void time_wheel::list_add(util_timer* head, util_timer* timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+void time_wheel::list_del(util_timer* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+//根据离到期还有多少个刻度选择层和槽
+void time_wheel::internal_add(util_timer* timer) {
+    uint64_t expire = timer->expire;
+    uint64_t idx = expire - m_jiffies;
+    util_timer* slot;
+    //已经过期的定时器放到当前槽，下一次tick立即处理
+    if (expire < m_jiffies) {
+        slot = &m_tv1[m_jiffies & TVR_MASK];
+    } else if (idx < (uint64_t)TVR_SIZE) {
+        slot = &m_tv1[expire & TVR_MASK];
+    } else {
+        int level = 0;
+        while (level < LEVELS - 1 && idx >= (1ULL << (TVR_BITS + (level + 1) * TVN_BITS))) {
+            ++level;
+        }
+        //超出最高层范围的定时器放到最高层最远的槽，走到时会再次下放
+        if (idx >= (1ULL << (TVR_BITS + LEVELS * TVN_BITS))) {
+            expire = m_jiffies + (1ULL << (TVR_BITS + LEVELS * TVN_BITS)) - 1;
+        }
+        slot = &m_tvn[level][(expire >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK];
     }
-    //被调整定时器是链表头结点，将定时器取出，重新插入
-    if (timer == head) {
-        head = head->next;
-        head->prev = NULL;
-        timer->next = NULL;
-        add_timer(timer, head);
+    list_add(slot, timer);
+}
+
+//把高层某个槽上的定时器全部重新插入，它们会落到更低的层
+void time_wheel::cascade(util_timer* slot) {
+    util_timer head;
+    list_init(&head);
+    if (slot->next != slot) {
+        head.next = slot->next;
+        head.prev = slot->prev;
+        head.next->prev = &head;
+        head.prev->next = &head;
+        list_init(slot);
     }
-    //被调整定时器在内部，将定时器取出，重新插入到其原来所在位置之后的部分链表中
-    else {
-        timer->prev->next = timer->next;
-        timer->next->prev = timer->prev;
-        add_timer(timer, timer->next);
+    while (head.next != &head) {
+        util_timer* timer = head.next;
+        list_del(timer);
+        internal_add(timer);
     }
 }
 
- //将目标定时器timer从链表中删除
-void sort_timer_lst::del_timer(util_timer* timer) {
+//将目标定时器timer添加到时间轮中
+void time_wheel::add_timer(util_timer* timer) {
     if (!timer) {
         return;
     }
-     //链表中只有一个定时器，需要删除该定时器
-    if ((timer == head) && (timer == tail)) {
-        delete timer;
-        head = NULL;
-        tail = NULL;
+    internal_add(timer);
+    ++m_count;
+}
+
+//调整定时器，任务发生变化时，先摘下再按新的超时时间插入，O(1)
+void time_wheel::adjust_timer(util_timer* timer) {
+    if (!timer) {
         return;
     }
-    //链表中至少有2个定时器且被删除的定时器为头结点
-    if (timer == head) {
-        head = head->next;
-        head->prev = NULL;
-        delete timer;
-        return;
+    if (timer->pending()) {
+        list_del(timer);
+    } else {
+        ++m_count;
     }
-    //链表中至少有2个定时器且被删除的定时器为尾结点
-    if (timer == tail) {
-        tail = tail->prev;
-        tail->next = nullptr;
-        delete timer;
+    internal_add(timer);
+}
+
+//将目标定时器timer从时间轮中删除
+void time_wheel::del_timer(util_timer* timer) {
+    if (!timer || !timer->pending()) {
         return;
     }
-    //被删除的定时器在链表内部，常规链表结点删除
-    timer->prev->next = timer->next;
-    timer->next->prev = timer->prev;
-    delete timer;
+    list_del(timer);
+    --m_count;
 }
 
-//SIGALRM信号每次被触发就在其信号处理函数中执行一次tick函数，以处理链表上到期的任务
-void sort_timer_lst::tick() {
-    if (!head) {
-        return;
+//从上次走到的刻度一直走到当前时间，处理途经各槽上到期的任务
+void time_wheel::tick() {
+    uint64_t now = current_ms();
+    while (m_jiffies <= now) {
+        int index = m_jiffies & TVR_MASK;
+        //第一层走完一圈时，从上一层取下一个槽下放，逐层进位
+        if (index == 0) {
+            for (int l = 0; l < LEVELS; ++l) {
+                int idx = (m_jiffies >> (TVR_BITS + l * TVN_BITS)) & TVN_MASK;
+                cascade(&m_tvn[l][idx]);
+                if (idx != 0) {
+                    break;
+                }
+            }
+        }
+        util_timer* slot = &m_tv1[index];
+        while (slot->next != slot) {
+            util_timer* timer = slot->next;
+            list_del(timer);            //先摘下再回调，回调中可以安全地重新添加或删除定时器
+            --m_count;
+            timer->cb_func(timer->user_data);
+        }
+        ++m_jiffies;
+    }
+}
+
+int time_wheel::next_expire() {
+    if (m_count == 0) {
+        return -1;
     }
-    time_t cur = time(NULL);        //获得系统当前的时间
-    util_timer* tmp = head;
-    //从头结点开始依次处理每个定时器， 直到遇到一个尚未到期的定时器，这是该定时器的核心逻辑
-    while (tmp) {
-        //链表容器为升序排列,每个定时器都使用绝对时间作为超时值,当前时间小于定时器的超时时间，后面的定时器也没有到期
-        if (cur < tmp->expire) {
+    //m_jiffies是下一个要处理的刻度,从它开始找第一个非空的槽,最多找到第一层本圈结束
+    uint64_t expire = m_jiffies;
+    for (int i = 0; i < TVR_SIZE; ++i, ++expire) {
+        if (i > 0 && (expire & TVR_MASK) == 0) {
             break;
         }
-        tmp->cb_func(tmp->user_data);       //当前定时器到期,调用定时器的回调函数，以执行定时任务
-        /* 执行完定时器的定时任务后，就将它从链表中删除，并重置链表头节点 */
-        head = tmp->next;
-        if (head) {
-            head->prev = nullptr;
-        }
-        delete tmp;
-        tmp = head;
-    }
-}
-
-/* 一个辅助函数。它是私有成员，被公有成员add_timer和adjust_time调用 。
-作用是将目标定时器timer添加到节点lst_head之后的部分链表中*/
-void sort_timer_lst::add_timer(util_timer* timer, util_timer* list_head) {
-    util_timer* prev = list_head;
-    util_timer* tmp = prev->next;
-    while (tmp) {
-        if (timer->expire < tmp->expire) {
-            prev->next = timer;
-            timer->next = tmp;
-            tmp->prev = timer;
-            timer->prev = prev;
+        util_timer* slot = &m_tv1[expire & TVR_MASK];
+        if (slot->next != slot) {
             break;
         }
-        prev = tmp;
-        tmp = tmp->next;
-    }
-    //遍历完未发现，则目标定时器需要放到尾结点处
-    if (!tmp) {
-        prev->next = timer;
-        timer->prev = prev;
-        timer->next = nullptr;
-        tail = timer;
     }
+    uint64_t now = current_ms();
+    return expire <= now ? 0 : (int)(expire - now);
 }
 
 void Utils::init(int timeslot) {
@@ -175,16 +203,6 @@ void Utils::addfd(int epollfd, int fd, bool one_shot, int TRIGMode) {
     setnonblocking(fd);
 }
 
-//信号处理函数
-void Utils::sig_handler(int sig) {
-    //为保证函数的可重入性，保留原来的errno
-    //可重入性表示中断后再次进入该函数，环境变量与之前相同，不会丢失数据
-    int save_errno = errno;
-    int msg = sig;
-    send(u_pipefd[1], (char*)&msg, 1, 0);   //将信号值从管道写端写入，传输字符类型，而非整型
-    errno = save_errno;
-}
-
 //设置信号函数
 void Utils::addsig(int sig, void(handler)(int), bool restart) {
     //创建sigaction结构体变量
@@ -201,10 +219,10 @@ void Utils::addsig(int sig, void(handler)(int), bool restart) {
     assert(sigaction(sig, &sa, NULL) != -1);
 }
 
-//定时处理任务，重新定时以不断触发SIGALRM信号
+//定时处理任务，推进时间轮到当前时间并执行到期的回调
+//由事件循环在每次epoll_wait返回后调用，没有到期的槽时只是比较一次时间
 void Utils::timer_handler() {
-    m_timer_lst.tick();     //定时处理任务，实际上就是调用tick函数
-    alarm(m_TIMESLOT);      //因为一次alarm调用只会引起一次SIGALRM信号，所以要重新定时，以不断的触发SIGALRM信号
+    m_time_wheel.tick();
 }
 
 void Utils::show_error(int connfd, const char* info) {
@@ -212,15 +230,15 @@ void Utils::show_error(int connfd, const char* info) {
     close(connfd);
 }
 
-int* Utils::u_pipefd = 0;
-int Utils::u_epollfd = 0;
-
 class Utils;
 //定时器回调函数，它删除非活动连接socket上的注册事件，并关闭之
+//连接对象在close之前归还连接表,user_data随之失效
 void cb_func(client_data* user_data) {
-    epoll_ctl(Utils::u_epollfd, EPOLL_CTL_DEL, user_data->sockfd, 0);
     assert(user_data);
-    close(user_data->sockfd);
+    int sockfd = user_data->sockfd;
+    epoll_ctl(user_data->epollfd, EPOLL_CTL_DEL, sockfd, 0);
+    conn_table::get_instance()->free(sockfd);
+    close(sockfd);
     http_conn::m_user_count--;
 }
 
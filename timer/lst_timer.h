@@ -22,46 +22,72 @@
 #include <sys/uio.h>
 
 #include <time.h>
+#include <stdint.h>
 #include "../log/log.h"
 
-class util_timer;
+struct client_data;
 
-//用户数据结构：客户端socket、 socket文件描述符、定时器
-struct client_data {
-    sockaddr_in address;
-    int sockfd;
-    util_timer* timer;
-};
-
-//定时器类
+//定时器结点:直接嵌入client_data,由时间轮槽位上的双向循环链表串起,不再单独new/delete
 class util_timer {
 public:
-    util_timer(): prev(NULL), next(NULL) {}
+    util_timer(): expire(0), cb_func(NULL), user_data(NULL), prev(NULL), next(NULL) {}
+
+    //是否挂在时间轮上,到期或删除后为false
+    bool pending() const { return prev != NULL; }
 
 public:
-    time_t expire;          //任务的超时时间，此处为绝对时间
+    uint64_t expire;        //任务的超时时间，此处为单调时钟上的绝对时间(毫秒)
     void (*cb_func)(client_data*);   //任务回调函数
     client_data* user_data;     //回调函数处理的客户数据，由定时器的执行者传递给回调函数
     util_timer* prev;           //指向前一个定时器
     util_timer* next;           //指向后一个定时器
 };
 
-//定时器链表：它是一个升序、双向链表，且带有头节点和尾节点。
-class sort_timer_lst {
+//用户数据结构：客户端socket地址、 socket文件描述符、所属epoll、定时器
+struct client_data {
+    sockaddr_in address;
+    int sockfd;
+    int epollfd;        //连接所属反应堆的epoll文件描述符
+    util_timer timer;
+};
+
+//单调时钟的当前时间(毫秒),时间轮以毫秒为一个刻度
+uint64_t current_ms();
+
+//分层时间轮:第一层256个槽,每槽1毫秒;其余四层各64个槽,每层一个槽覆盖下一层一整圈
+//添加、调整和删除都是O(1),tick时只检查走过的槽,高层的槽走到时整体下放到低层
+class time_wheel {
 public:
-    sort_timer_lst();
-    ~sort_timer_lst();
+    time_wheel();
+    ~time_wheel();
 
     void add_timer(util_timer* timer);
     void adjust_timer(util_timer* timer);
     void del_timer(util_timer* timer);
     void tick();
+    //距离最近一个可能到期的定时器还有多少毫秒,已到期返回0,没有定时器返回-1,可直接作为epoll_wait的超时时间
+    //只查看第一层,第一层剩余的槽都为空时返回到本圈结束的时间,届时高层的槽会下放
+    int next_expire();
 
 private:
-    void add_timer(util_timer* timer, util_timer* lst_head);
-    util_timer* head;
-    util_timer* tail;
-
+    static const int TVR_BITS = 8;
+    static const int TVN_BITS = 6;
+    static const int TVR_SIZE = 1 << TVR_BITS;
+    static const int TVN_SIZE = 1 << TVN_BITS;
+    static const int TVR_MASK = TVR_SIZE - 1;
+    static const int TVN_MASK = TVN_SIZE - 1;
+    static const int LEVELS = 4;    //第一层之外的层数
+
+    void internal_add(util_timer* timer);
+    void cascade(util_timer* slot);
+    static void list_init(util_timer* head);
+    static void list_add(util_timer* head, util_timer* timer);
+    static void list_del(util_timer* timer);
+
+    uint64_t m_jiffies;     //时间轮当前走到的刻度
+    int m_count;            //时间轮上的定时器个数
+    util_timer m_tv1[TVR_SIZE];             //每个槽是带头结点的双向循环链表
+    util_timer m_tvn[LEVELS][TVN_SIZE];
 };
 
 class Utils {
@@ -78,21 +104,16 @@ public:
     //将内核事件表注册读事件，ET模式，选择开启EPOLLONESHOT
     void addfd(int epollfd, int fd, bool one_shot, int TRIGMode);
 
-    //信号处理函数
-    static void sig_handler(int sig);
-
     //设置信号函数
     void addsig(int sig, void(handler)(int), bool restart = true);
 
-    //定时处理任务，重新定时以不断触发SIGALRM信号
+    //定时处理任务，推进时间轮并执行到期的回调
     void timer_handler();
 
     void show_error(int connfd, const char* info);
 
 public:
-    static int* u_pipefd;
-    sort_timer_lst m_timer_lst;
-    static int u_epollfd;
+    time_wheel m_time_wheel;
     int m_TIMESLOT;
 
 };
@@ -0,0 +1,302 @@
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "uring.h"
+
+#ifdef HAVE_IO_URING
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+#endif
+
+uring::uring() {
+    m_ring_fd = -1;
+    m_sq_ptr = NULL;
+    m_cq_ptr = NULL;
+    m_sqes = NULL;
+    m_buf_ring = NULL;
+    m_bufs = NULL;
+    m_sqe_tail = 0;
+}
+
+uring::~uring() {
+    if (m_buf_ring) {
+        munmap(m_buf_ring, m_buf_ring_len);
+    }
+    free(m_bufs);
+    if (m_sqes) {
+        munmap(m_sqes, m_sqes_len);
+    }
+    if (m_cq_ptr && m_cq_ptr != m_sq_ptr) {
+        munmap(m_cq_ptr, m_cq_len);
+    }
+    if (m_sq_ptr) {
+        munmap(m_sq_ptr, m_sq_len);
+    }
+    if (m_ring_fd != -1) {
+        close(m_ring_fd);
+    }
+}
+
+bool uring::init(unsigned entries, unsigned buf_count, unsigned buf_size) {
+#ifdef HAVE_IO_URING
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    m_ring_fd = sys_io_uring_setup(entries, &p);
+    if (m_ring_fd < 0) {
+        m_ring_fd = -1;
+        return false;
+    }
+
+    //映射提交队列、完成队列和提交项数组,新内核上前两者可以共用一次mmap
+    m_sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        m_sq_len = m_cq_len = (m_sq_len > m_cq_len) ? m_sq_len : m_cq_len;
+    }
+    void* ptr = mmap(0, m_sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    m_sq_ptr = ptr;
+    if (single_mmap) {
+        m_cq_ptr = m_sq_ptr;
+    } else {
+        ptr = mmap(0, m_cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        m_cq_ptr = ptr;
+    }
+    m_sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(0, m_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    m_sqes = ptr;
+
+    char* sq = (char*)m_sq_ptr;
+    m_sq_head = (unsigned*)(sq + p.sq_off.head);
+    m_sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    m_sq_mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    m_sq_array = (unsigned*)(sq + p.sq_off.array);
+    m_sq_entries = p.sq_entries;
+    m_sqe_tail = *m_sq_tail;
+
+    char* cq = (char*)m_cq_ptr;
+    m_cq_head = (unsigned*)(cq + p.cq_off.head);
+    m_cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    m_cq_mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    m_cqes = cq + p.cq_off.cqes;
+
+    //注册provided buffer ring,内核在数据到达时才从中选取接收缓冲区
+    m_buf_count = buf_count;
+    m_buf_size = buf_size;
+    m_buf_ring_len = buf_count * sizeof(struct io_uring_buf);
+    ptr = mmap(NULL, m_buf_ring_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    m_buf_ring = ptr;
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)m_buf_ring;
+    reg.ring_entries = buf_count;
+    reg.bgid = 0;
+    if (sys_io_uring_register(m_ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return false;
+    }
+    m_bufs = (char*)malloc((size_t)buf_count * buf_size);
+    if (!m_bufs) {
+        return false;
+    }
+    for (unsigned i = 0; i < buf_count; ++i) {
+        recycle_buffer(i);
+    }
+    return true;
+#else
+    (void)entries;
+    (void)buf_count;
+    (void)buf_size;
+    return false;
+#endif
+}
+
+void* uring::get_sqe() {
+#ifdef HAVE_IO_URING
+    unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    if (m_sqe_tail - head >= m_sq_entries) {
+        submit_and_wait(0);
+        head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+        if (m_sqe_tail - head >= m_sq_entries) {
+            return NULL;
+        }
+    }
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)m_sqes + (m_sqe_tail & m_sq_mask);
+    m_sq_array[m_sqe_tail & m_sq_mask] = m_sqe_tail & m_sq_mask;
+    ++m_sqe_tail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+#else
+    return NULL;
+#endif
+}
+
+bool uring::prep_accept(int fd, bool multishot, uint64_t user_data) {
+#ifdef HAVE_IO_URING
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)get_sqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    if (multishot) {
+        sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+    }
+    sqe->user_data = user_data;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool uring::prep_recv(int fd, uint64_t user_data) {
+#ifdef HAVE_IO_URING
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)get_sqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->len = m_buf_size;
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = user_data;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool uring::prep_writev(int fd, const struct iovec* iov, int iovcnt, uint64_t user_data, bool link) {
+#ifdef HAVE_IO_URING
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)get_sqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = iovcnt;
+    if (link) {
+        sqe->flags |= IOSQE_IO_LINK;
+    }
+    sqe->user_data = user_data;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool uring::prep_poll(int fd, unsigned events, uint64_t user_data) {
+#ifdef HAVE_IO_URING
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)get_sqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+    return true;
+#else
+    return false;
+#endif
+}
+
+int uring::submit_and_wait(unsigned wait_nr) {
+#ifdef HAVE_IO_URING
+    __atomic_store_n(m_sq_tail, m_sqe_tail, __ATOMIC_RELEASE);
+    //上一次被信号打断时可能还有未被内核取走的提交项,一并提交
+    unsigned to_submit = m_sqe_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    if (to_submit == 0 && wait_nr == 0) {
+        return 0;
+    }
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    int ret = sys_io_uring_enter(m_ring_fd, to_submit, wait_nr, flags);
+    return ret < 0 ? -errno : ret;
+#else
+    (void)wait_nr;
+    return -ENOSYS;
+#endif
+}
+
+bool uring::next_cqe(uint64_t& user_data, int& res, unsigned& flags) {
+#ifdef HAVE_IO_URING
+    unsigned head = *m_cq_head;
+    if (head == __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    struct io_uring_cqe* cqe = (struct io_uring_cqe*)m_cqes + (head & m_cq_mask);
+    user_data = cqe->user_data;
+    res = cqe->res;
+    flags = cqe->flags;
+    __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+#else
+    (void)user_data;
+    (void)res;
+    (void)flags;
+    return false;
+#endif
+}
+
+bool uring::cqe_more(unsigned flags) {
+#ifdef HAVE_IO_URING
+    return flags & IORING_CQE_F_MORE;
+#else
+    (void)flags;
+    return false;
+#endif
+}
+
+int uring::cqe_buffer(unsigned flags) {
+#ifdef HAVE_IO_URING
+    if (!(flags & IORING_CQE_F_BUFFER)) {
+        return -1;
+    }
+    return flags >> IORING_CQE_BUFFER_SHIFT;
+#else
+    (void)flags;
+    return -1;
+#endif
+}
+
+void uring::recycle_buffer(unsigned short bid) {
+#ifdef HAVE_IO_URING
+    //本线程是buffer ring唯一的生产者,tail与第0项的保留字段重叠
+    //bufs用__DECLARE_FLEX_ARRAY声明,其中的空结构体在C++中占1字节,br->bufs会比内核看到的位置后移8字节,因此按数组直接取项
+    struct io_uring_buf_ring* br = (struct io_uring_buf_ring*)m_buf_ring;
+    unsigned short tail = br->tail;
+    struct io_uring_buf* buf = (struct io_uring_buf*)m_buf_ring + (tail & (m_buf_count - 1));
+    buf->addr = (uint64_t)(uintptr_t)buffer(bid);
+    buf->len = m_buf_size;
+    buf->bid = bid;
+    __atomic_store_n(&br->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+#else
+    (void)bid;
+#endif
+}
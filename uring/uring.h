@@ -0,0 +1,90 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+
+//内核头文件需要支持provided buffer ring(5.19+),否则io_uring后端整体不可用,运行时回退到epoll
+//IORING_REGISTER_PBUF_RING是枚举值而不是宏,只能按头文件的版本判断;运行的内核不支持时由init在创建或注册失败时返回false
+#if defined(__has_include) && defined(__NR_io_uring_setup)
+#if __has_include(<linux/io_uring.h>) && __has_include(<linux/version.h>)
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+//io_uring的最小封装:直接使用系统调用,不依赖liburing
+//提交和收割都在同一个反应堆线程中完成,因此不加锁
+class uring {
+public:
+    uring();
+    ~uring();
+
+    //创建ring并注册provided buffer ring,内核不支持时返回false
+    //buf_count必须是2的幂
+    bool init(unsigned entries, unsigned buf_count, unsigned buf_size);
+
+    //以下prep_*只填写提交项,在下一次submit_and_wait时统一提交
+    //提交队列已满时先提交已填写的提交项再重试,仍然放不下时返回false
+    bool prep_accept(int fd, bool multishot, uint64_t user_data);
+    //从provided buffer组中由内核选一块缓冲区接收数据
+    bool prep_recv(int fd, uint64_t user_data);
+    //link为true时,下一个提交项要等本次写完成后才开始执行
+    bool prep_writev(int fd, const struct iovec* iov, int iovcnt, uint64_t user_data, bool link);
+    bool prep_poll(int fd, unsigned events, uint64_t user_data);
+
+    //提交全部提交项,并至少等待wait_nr个完成项;返回负的errno表示失败
+    int submit_and_wait(unsigned wait_nr);
+
+    //取出下一个完成项,没有时返回false
+    bool next_cqe(uint64_t& user_data, int& res, unsigned& flags);
+    //多次触发的提交项(multishot)是否仍然有效
+    static bool cqe_more(unsigned flags);
+    //完成项使用的provided buffer编号,没有使用时返回-1
+    static int cqe_buffer(unsigned flags);
+
+    char* buffer(unsigned short bid) { return m_bufs + (size_t)bid * m_buf_size; }
+    //把用完的provided buffer归还给内核
+    void recycle_buffer(unsigned short bid);
+
+private:
+    void* get_sqe();
+
+private:
+    int m_ring_fd;
+
+    //提交队列
+    unsigned* m_sq_head;
+    unsigned* m_sq_tail;
+    unsigned m_sq_mask;
+    unsigned* m_sq_array;
+    void* m_sqes;
+    unsigned m_sq_entries;
+    unsigned m_sqe_tail;        //已填写的提交项尾部
+
+    //完成队列
+    unsigned* m_cq_head;
+    unsigned* m_cq_tail;
+    unsigned m_cq_mask;
+    void* m_cqes;
+
+    void* m_sq_ptr;
+    size_t m_sq_len;
+    void* m_cq_ptr;
+    size_t m_cq_len;
+    size_t m_sqes_len;
+
+    //provided buffer ring
+    void* m_buf_ring;
+    size_t m_buf_ring_len;
+    unsigned m_buf_count;
+    unsigned m_buf_size;
+    char* m_bufs;
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include "webserver.h"
+
+sub_reactor::sub_reactor() {
+    m_server = NULL;
+    m_epollfd = -1;
+    m_own_epollfd = false;
+    m_evfd = -1;
+    m_started = false;
+    m_stop = false;
+    m_events = NULL;
+}
+
+sub_reactor::~sub_reactor() {
+    if (m_started) {
+        stop();
+        pthread_join(m_thread, NULL);
+    }
+    if (m_evfd != -1) {
+        close(m_evfd);
+    }
+    if (m_own_epollfd) {
+        close(m_epollfd);
+    }
+    delete[] m_events;
+}
+
+void sub_reactor::init(WebServer* server, int epollfd) {
+    m_server = server;
+    m_close_log = server->m_close_log;
+    utils.init(TIMESLOT);
+
+    //单反应堆模式:与主线程共用epoll,由WebServer::eventLoop直接调用handle_event
+    if (epollfd != -1) {
+        m_epollfd = epollfd;
+        utils.addfd(m_epollfd, m_cq.fd(), false, 0);
+        return;
+    }
+    m_epollfd = epoll_create(5);
+    assert(m_epollfd != -1);
+    m_own_epollfd = true;
+    utils.addfd(m_epollfd, m_cq.fd(), false, 0);
+
+    m_evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(m_evfd != -1);
+    utils.addfd(m_epollfd, m_evfd, false, 0);
+
+    m_events = new epoll_event[MAX_EVENT_NUMBER];
+}
+
+void sub_reactor::start() {
+    if (pthread_create(&m_thread, NULL, worker, this) != 0) {
+        throw std::exception();
+    }
+    m_started = true;
+}
+
+//SIGTERM在创建线程前已被屏蔽并由主线程的signalfd接收,子反应堆线程不会被信号打断
+void* sub_reactor::worker(void* arg) {
+    sub_reactor* reactor = (sub_reactor*)arg;
+    reactor->loop();
+    return reactor;
+}
+
+//主反应堆线程调用:单反应堆模式直接接管,否则放入待处理队列并唤醒子反应堆
+void sub_reactor::dispatch(int connfd, const sockaddr_in& client_address) {
+    if (m_evfd == -1) {
+        timer(connfd, client_address);
+        return;
+    }
+    m_lock.lock();
+    m_pending.push_back(std::make_pair(connfd, client_address));
+    m_lock.unlock();
+    uint64_t one = 1;
+    ::write(m_evfd, &one, sizeof(one));
+}
+
+void sub_reactor::stop() {
+    m_lock.lock();
+    m_stop = true;
+    m_lock.unlock();
+    uint64_t one = 1;
+    ::write(m_evfd, &one, sizeof(one));
+}
+
+void sub_reactor::tick() {
+    utils.timer_handler();
+}
+
+int sub_reactor::next_timeout() {
+    return utils.m_time_wheel.next_expire();
+}
+
+//取出主反应堆交来的新连接和通知
+void sub_reactor::dealwithnotify() {
+    uint64_t cnt;
+    ::read(m_evfd, &cnt, sizeof(cnt));
+
+    std::list<std::pair<int, sockaddr_in> > pending;
+    m_lock.lock();
+    pending.swap(m_pending);
+    m_lock.unlock();
+
+    for (std::list<std::pair<int, sockaddr_in> >::iterator it = pending.begin(); it != pending.end(); ++it) {
+        timer(it->first, it->second);
+    }
+}
+
+void sub_reactor::loop() {
+    while (true) {
+        int number = epoll_wait(m_epollfd, m_events, MAX_EVENT_NUMBER, next_timeout());
+        if (number < 0 && errno != EINTR) {
+            LOG_ERROR("%s", "sub reactor epoll failure");
+            break;
+        }
+        for (int i = 0; i < number; ++i) {
+            if (m_events[i].data.fd == m_evfd) {
+                dealwithnotify();
+            } else {
+                handle_event(m_events[i]);
+            }
+        }
+        tick();
+        m_lock.lock();
+        bool stop_now = m_stop;
+        m_lock.unlock();
+        if (stop_now) {
+            break;
+        }
+    }
+}
+
+void sub_reactor::handle_event(const epoll_event& event) {
+    int sockfd = event.data.fd;
+    //工作线程完成了reactor模式的读写任务
+    if (sockfd == m_cq.fd()) {
+        dealwithcompletion();
+    }
+    //同一批事件中前面的完成项可能已经关闭了该连接
+    else if (!m_server->m_conns->get(sockfd)) {
+        return;
+    }
+    else if (event.events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        //服务器端关闭连接，移除对应的定时器
+        util_timer* timer = &m_server->m_conns->get_data(sockfd)->timer;
+        deal_timer(timer, sockfd);
+    }
+    //处理客户连接上接收到的数据
+    else if (event.events & EPOLLIN) {
+        dealwithread(sockfd);
+    }
+    else if (event.events & EPOLLOUT) {
+        dealwithwrite(sockfd);
+    }
+}
+
+void sub_reactor::timer(int connfd, struct sockaddr_in client_address) {
+    //从连接表分配连接对象
+    http_conn* conn = m_server->m_conns->alloc(connfd);
+    conn->init(connfd, client_address, m_epollfd, m_server->m_root, m_server->m_CONNTrigmode, m_close_log);
+    conn->m_cq = &m_cq;
+    conn->m_worker_io = (m_server->m_actormodel == 1);
+
+    //初始化client_data数据
+    //设置内嵌定时器的回调函数和超时时间，绑定用户数据，将定时器添加到时间轮中
+    client_data* data = m_server->m_conns->get_data(connfd);
+    data->address = client_address;
+    data->sockfd = connfd;
+    data->epollfd = m_epollfd;
+    util_timer* timer = &data->timer;
+    timer->user_data = data;                    //设置定时器对应的连接资源
+    timer->cb_func = cb_func;                   //设置回调函数
+    timer->expire = current_ms() + 3 * TIMESLOT * 1000;     //设置绝对超时时间
+    utils.m_time_wheel.add_timer(timer);        //将该定时器添加到时间轮中
+}
+
+//若某个客户连接上有数据传输，则将定时器往后延迟3个单位
+//并对新的定时器在时间轮上的位置进行调整
+void sub_reactor::adjust_timer(util_timer* timer) {
+    timer->expire = current_ms() + 3 * TIMESLOT * 1000;
+    utils.m_time_wheel.adjust_timer(timer);
+
+    LOG_INFO("%s", "adjust timer once");
+}
+
+//处理定时器,定时器已不在时间轮上说明连接已经关闭
+//回调会把连接对象归还连接表,之后不能再访问timer
+void sub_reactor::deal_timer(util_timer* timer, int sockfd) {
+    if (!timer->pending()) {
+        return;
+    }
+    utils.m_time_wheel.del_timer(timer);
+    timer->cb_func(timer->user_data);
+    LOG_INFO("close fd %d", sockfd);
+}
+
+//reactor模式下把读写任务交给工作线程,入队成功后才摘下定时器,工作线程处理期间超时不会关闭连接,回收完成项时再挂回
+//请求队列已满时连接不会再被注册事件,也不会有完成项,直接关闭
+void sub_reactor::dispatch(http_conn* conn, util_timer* timer, int sockfd, int state) {
+    if (!m_server->m_pool->append(conn, state)) {
+        LOG_ERROR("request queue is full, close fd %d", sockfd);
+        deal_timer(timer, sockfd);
+        return;
+    }
+    utils.m_time_wheel.del_timer(timer);
+}
+
+//sockfd上有可读事件时，epoll_wait通知本反应堆处理
+void sub_reactor::dealwithread(int sockfd) {
+    http_conn* conn = m_server->m_conns->get(sockfd);
+    util_timer* timer = &m_server->m_conns->get_data(sockfd)->timer;
+
+    //reactor
+    if (m_server->m_actormodel == 1) {
+        //若监测到读事件，将读取到的数据封装成一个请求对象并插入请求队列
+        //不等待工作线程,处理结果由dealwithcompletion回收
+        dispatch(conn, timer, sockfd, 0);
+    }
+    //proactor
+    else {
+        if (conn->read_once()) {
+            LOG_INFO("deal with the client(%s)", inet_ntoa(conn->get_address()->sin_addr));
+
+            m_server->m_pool->append_p(conn);
+            adjust_timer(timer);
+
+        } else {
+            deal_timer(timer, sockfd);
+        }
+    }
+}
+
+//sockfd上有可写事件时，epoll_wait通知本反应堆。往socket上写入服务器处理客户请求的结果
+void sub_reactor::dealwithwrite(int sockfd) {
+    http_conn* conn = m_server->m_conns->get(sockfd);
+    util_timer* timer = &m_server->m_conns->get_data(sockfd)->timer;
+    //reactor
+    if (m_server->m_actormodel == 1) {
+        dispatch(conn, timer, sockfd, 1);
+    }
+    //proacotr
+    else {
+        bool pending = false;
+        if (conn->write(&pending)) {
+            LOG_INFO("send data to the client(%s)", inet_ntoa(conn->get_address()->sin_addr));
+            adjust_timer(timer);
+            //流水线中的下一个请求已在读缓冲区中,不等待读事件直接交给工作线程
+            if (pending) {
+                m_server->m_pool->append_p(conn);
+            }
+        }
+        else {
+            deal_timer(timer, sockfd);
+        }
+    }
+}
+
+//回收工作线程在reactor模式下完成的读写任务,读写失败的连接在反应堆线程中关闭
+//其余连接在这里才挂回定时器并重新注册事件,完成项回收之前连接不会被再次派发或关闭,队列中不会留下失效的指针
+void sub_reactor::dealwithcompletion() {
+    std::list<http_conn*> done;
+    m_cq.drain(done);
+    for (std::list<http_conn*>::iterator it = done.begin(); it != done.end(); ++it) {
+        http_conn* request = *it;
+        int sockfd = request->get_sockfd();
+        util_timer* timer = &m_server->m_conns->get_data(sockfd)->timer;
+        if (request->timer_flag == 1) {
+            request->timer_flag = 0;
+            timer->cb_func(timer->user_data);
+            LOG_INFO("close fd %d", sockfd);
+        } else {
+            adjust_timer(timer);
+            request->rearm();
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef SUB_REACTOR_H
+#define SUB_REACTOR_H
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <list>
+#include <utility>
+
+#include "../lock/locker.h"
+#include "../timer/lst_timer.h"
+#include "../threadpool/completion_queue.h"
+#include "../http/http_conn.h"
+
+class WebServer;
+
+//子反应堆:独占一个epoll实例、自己那部分连接以及一个定时器时间轮
+//主反应堆accept到新连接后通过eventfd交给某个子反应堆,此后该连接的所有事件都只在这个线程里处理
+class sub_reactor {
+public:
+    sub_reactor();
+    ~sub_reactor();
+
+    //epollfd为-1时创建独立的epoll实例;单反应堆模式下直接复用主线程的epoll
+    void init(WebServer* server, int epollfd = -1);
+    //创建子反应堆线程
+    void start();
+    //主反应堆把新连接交给本反应堆
+    void dispatch(int connfd, const sockaddr_in& client_address);
+    //通知子反应堆线程退出
+    void stop();
+
+    //处理本反应堆上某个连接的就绪事件
+    void handle_event(const epoll_event& event);
+    //处理本反应堆时间轮上到期的任务
+    void tick();
+    //距离最近一个定时器到期的毫秒数,作为epoll_wait的超时时间
+    int next_timeout();
+
+    void timer(int connfd, struct sockaddr_in client_address);
+    void adjust_timer(util_timer* timer);
+    void deal_timer(util_timer* timer, int sockfd);
+    void dispatch(http_conn* conn, util_timer* timer, int sockfd, int state);
+    void dealwithread(int sockfd);
+    void dealwithwrite(int sockfd);
+    void dealwithcompletion();
+
+private:
+    static void* worker(void* arg);
+    void loop();
+    void dealwithnotify();
+
+public:
+    int m_epollfd;
+    Utils utils;        //本反应堆的定时器时间轮
+
+private:
+    WebServer* m_server;
+    int m_close_log;
+    bool m_own_epollfd;
+    int m_evfd;             //eventfd,主反应堆写入以唤醒子反应堆
+    completion_queue<http_conn> m_cq;   //reactor模式下工作线程投递处理结果
+    pthread_t m_thread;
+    bool m_started;
+
+    locker m_lock;          //保护以下两个成员
+    std::list<std::pair<int, sockaddr_in> > m_pending;  //等待本反应堆接管的新连接
+    bool m_stop;
+
+    epoll_event* m_events;
+};
+
+#endif
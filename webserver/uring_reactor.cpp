@@ -0,0 +1,375 @@
+#include <poll.h>
+#include <sys/timerfd.h>
+#include "webserver.h"
+
+//io_uring后端的定时器回调:连接上可能还有recv在内核中等待,直接close不会让它结束
+//因此只shutdown,等该recv以0或错误返回后再由反应堆统一关闭
+static void uring_cb_func(client_data* user_data) {
+    assert(user_data);
+    shutdown(user_data->sockfd, SHUT_RDWR);
+}
+
+uring_reactor::uring_reactor() {
+    m_server = NULL;
+    m_gen = NULL;
+    m_recving = NULL;
+    m_aborted = NULL;
+    m_multishot = true;
+    m_recycled = 0;
+    m_timerfd = -1;
+    m_armed = 0;
+}
+
+uring_reactor::~uring_reactor() {
+    if (m_timerfd != -1) {
+        close(m_timerfd);
+    }
+    delete[] m_gen;
+    delete[] m_recving;
+    delete[] m_aborted;
+}
+
+bool uring_reactor::init(WebServer* server) {
+    m_server = server;
+    m_close_log = server->m_close_log;
+    if (!m_ring.init(1024, 1024, http_conn::READ_BUFFER_SIZE)) {
+        return false;
+    }
+    m_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timerfd == -1) {
+        return false;
+    }
+    utils.init(TIMESLOT);
+    m_gen = new unsigned[server->m_conns->size()]();
+    m_recving = new bool[server->m_conns->size()]();
+    m_aborted = new bool[server->m_conns->size()]();
+    return true;
+}
+
+uint64_t uring_reactor::make_data(int op, int fd) {
+    unsigned gen = (fd >= 0) ? (m_gen[fd] & 0xffffff) : 0;
+    return ((uint64_t)op << 56) | ((uint64_t)gen << 32) | (uint32_t)fd;
+}
+
+//prep_*在提交队列已满时已经先提交一次再重试,仍然返回false说明内核没有取走提交项,这一轮不再重试
+void uring_reactor::submit_fixed(int op) {
+    bool ok = false;
+    switch (op) {
+        case OP_ACCEPT: {
+            ok = m_ring.prep_accept(m_server->m_listenfd, m_multishot, make_data(OP_ACCEPT, -1));
+            break;
+        }
+        case OP_SIGNAL: {
+            ok = m_ring.prep_poll(m_server->m_sigfd, POLLIN, make_data(OP_SIGNAL, -1));
+            break;
+        }
+        case OP_COMPLETION: {
+            ok = m_ring.prep_poll(m_cq.fd(), POLLIN, make_data(OP_COMPLETION, -1));
+            break;
+        }
+        case OP_TIMER: {
+            ok = m_ring.prep_poll(m_timerfd, POLLIN, make_data(OP_TIMER, -1));
+            break;
+        }
+    }
+    if (!ok) {
+        LOG_ERROR("io_uring submission queue full, op %d deferred", op);
+        m_deferred.push_back(op);
+    }
+}
+
+bool uring_reactor::submit_recv(int sockfd) {
+    if (!m_ring.prep_recv(sockfd, make_data(OP_RECV, sockfd))) {
+        m_recving[sockfd] = false;
+        abort_conn(sockfd);
+        return false;
+    }
+    m_recving[sockfd] = true;
+    return true;
+}
+
+//保持连接时把下一次recv链接在writev之后,写完立即开始读,不需要额外的提交
+//读缓冲区中已有流水线中的下一个请求时写完后直接处理它,不链接recv
+bool uring_reactor::submit_write(int sockfd) {
+    http_conn* conn = m_server->m_conns->get(sockfd);
+    int count = 0;
+    struct iovec* iov = conn->get_iovec(&count);
+    bool link = conn->get_linger() && !m_recving[sockfd] && !conn->request_ready();
+    if (!m_ring.prep_writev(sockfd, iov, count, make_data(OP_WRITE, sockfd), link)) {
+        abort_conn(sockfd);
+        return false;
+    }
+    //writev已经在提交队列中,不能关闭连接;放不下recv时m_recving保持false,写完后由dealwithwrite重新提交
+    if (link && m_ring.prep_recv(sockfd, make_data(OP_RECV, sockfd))) {
+        m_recving[sockfd] = true;
+    }
+    return true;
+}
+
+//内核中还有该连接的recv时只shutdown,等recv返回后由dealwithrecv关闭,与定时器回调相同
+//该recv也可能因链接的writev没有写完而被取消,此时同样关闭
+void uring_reactor::abort_conn(int sockfd) {
+    LOG_ERROR("io_uring submission queue full, close fd %d", sockfd);
+    if (m_recving[sockfd]) {
+        m_aborted[sockfd] = true;
+        shutdown(sockfd, SHUT_RDWR);
+    } else {
+        close_conn(sockfd);
+    }
+}
+
+void uring_reactor::recycle_buffer(int bid) {
+    m_ring.recycle_buffer(bid);
+    ++m_recycled;
+}
+
+//每归还一块缓冲区恢复一个连接;连接在等待期间被关闭时代数已变,直接丢弃
+void uring_reactor::resume_parked() {
+    while (m_recycled > 0 && !m_parked.empty()) {
+        uint64_t data = m_parked.front();
+        m_parked.pop_front();
+        int sockfd = (int)(uint32_t)data;
+        if (data == make_data(OP_RECV, sockfd)) {
+            submit_recv(sockfd);
+            --m_recycled;
+        }
+    }
+    m_recycled = 0;
+}
+
+void uring_reactor::timer(int connfd, struct sockaddr_in client_address) {
+    http_conn* conn = m_server->m_conns->alloc(connfd);
+    conn->init(connfd, client_address, -1, m_server->m_root, m_server->m_CONNTrigmode, m_close_log);
+    conn->m_cq = &m_cq;
+
+    client_data* data = m_server->m_conns->get_data(connfd);
+    data->address = client_address;
+    data->sockfd = connfd;
+    data->epollfd = -1;
+    util_timer* timer = &data->timer;
+    timer->user_data = data;
+    timer->cb_func = uring_cb_func;
+    timer->expire = current_ms() + 3 * TIMESLOT * 1000;
+    utils.m_time_wheel.add_timer(timer);
+}
+
+void uring_reactor::adjust_timer(util_timer* timer) {
+    timer->expire = current_ms() + 3 * TIMESLOT * 1000;
+    utils.m_time_wheel.adjust_timer(timer);
+
+    LOG_INFO("%s", "adjust timer once");
+}
+
+//只在该连接没有提交项在内核中时调用,代数加1后旧连接迟到的完成项都会被丢弃
+//accept也在本线程完成,因此可以先关闭再归还连接对象
+void uring_reactor::close_conn(int sockfd) {
+    utils.m_time_wheel.del_timer(&m_server->m_conns->get_data(sockfd)->timer);
+    m_server->m_conns->get(sockfd)->close_conn();
+    m_server->m_conns->free(sockfd);
+    ++m_gen[sockfd];
+    m_recving[sockfd] = false;
+    m_aborted[sockfd] = false;
+    LOG_INFO("close fd %d", sockfd);
+}
+
+//只在最近的到期时间提前时才重新设置,连接活跃时定时器不断后移,不必每轮都调用timerfd_settime
+//设置得偏早只会多唤醒一次,tick后再按新的到期时间设置
+void uring_reactor::arm_timer() {
+    int timeout = utils.m_time_wheel.next_expire();
+    if (timeout < 0) {
+        return;
+    }
+    uint64_t expire = current_ms() + timeout;
+    if (m_armed != 0 && m_armed <= expire) {
+        return;
+    }
+    //绝对时间已经过去时timerfd立即触发
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = expire / 1000;
+    its.it_value.tv_nsec = (expire % 1000) * 1000000;
+    timerfd_settime(m_timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+    m_armed = expire;
+}
+
+void uring_reactor::dealwithaccept(int res, unsigned flags) {
+    //旧内核不支持multishot accept,改为每次accept后重新提交
+    if (res == -EINVAL && m_multishot) {
+        m_multishot = false;
+        submit_fixed(OP_ACCEPT);
+        return;
+    }
+    if (!uring::cqe_more(flags)) {
+        submit_fixed(OP_ACCEPT);
+    }
+    if (res < 0) {
+        LOG_ERROR("%s:errno is:%d", "accept error", -res);
+        return;
+    }
+    int connfd = res;
+    if (connfd >= m_server->m_conns->size() || http_conn::m_user_count >= m_server->m_conns->size()) {
+        utils.show_error(connfd, "Internal server busy");
+        LOG_ERROR("%s", "Internal server busy");
+        return;
+    }
+    struct sockaddr_in client_address;
+    socklen_t client_addrlength = sizeof(client_address);
+    memset(&client_address, 0, sizeof(client_address));
+    getpeername(connfd, (struct sockaddr*)&client_address, &client_addrlength);
+    timer(connfd, client_address);
+    submit_recv(connfd);
+}
+
+void uring_reactor::dealwithrecv(int sockfd, int res, unsigned flags) {
+    m_recving[sockfd] = false;
+    int bid = uring::cqe_buffer(flags);
+    //writev没有写完时被链接的recv会被内核取消,由dealwithwrite在写完后重新提交
+    if (res == -ECANCELED) {
+        if (m_aborted[sockfd]) {
+            close_conn(sockfd);
+        }
+        return;
+    }
+    //provided buffer暂时用完,立即重新提交只会再次失败并空转;挂起到有缓冲区归还后再提交
+    if (res == -ENOBUFS) {
+        m_recving[sockfd] = true;
+        m_parked.push_back(make_data(OP_RECV, sockfd));
+        return;
+    }
+    if (res <= 0) {
+        if (bid >= 0) {
+            recycle_buffer(bid);
+        }
+        close_conn(sockfd);
+        return;
+    }
+    http_conn* conn = m_server->m_conns->get(sockfd);
+    bool ok = conn->read_from(m_ring.buffer(bid), res);
+    recycle_buffer(bid);
+    if (!ok) {
+        close_conn(sockfd);
+        return;
+    }
+    LOG_INFO("deal with the client(%s)", inet_ntoa(conn->get_address()->sin_addr));
+    m_server->m_pool->append_p(conn);
+    adjust_timer(&m_server->m_conns->get_data(sockfd)->timer);
+}
+
+void uring_reactor::dealwithwrite(int sockfd, int res) {
+    if (res < 0) {
+        close_conn(sockfd);
+        return;
+    }
+    http_conn* conn = m_server->m_conns->get(sockfd);
+    //只写出了一部分,继续写剩余部分
+    if (conn->advance_write(res)) {
+        submit_write(sockfd);
+        return;
+    }
+    if (!conn->finish_write()) {
+        close_conn(sockfd);
+        return;
+    }
+    //读缓冲区中已有下一个请求时直接交给工作线程;否则链接的recv被取消时需要重新提交
+    if (conn->request_ready()) {
+        m_server->m_pool->append_p(conn);
+    } else if (!m_recving[sockfd] && !submit_recv(sockfd)) {
+        return;
+    }
+    LOG_INFO("send data to the client(%s)", inet_ntoa(conn->get_address()->sin_addr));
+    adjust_timer(&m_server->m_conns->get_data(sockfd)->timer);
+}
+
+//工作线程处理完请求:请求不完整则继续读,否则提交应答;失败的连接在这里关闭
+void uring_reactor::dealwithcompletion() {
+    std::list<http_conn*> done;
+    m_cq.drain(done);
+    for (std::list<http_conn*>::iterator it = done.begin(); it != done.end(); ++it) {
+        http_conn* request = *it;
+        int sockfd = request->get_sockfd();
+        if (request->timer_flag == 1) {
+            request->timer_flag = 0;
+            close_conn(sockfd);
+        } else if (request->m_state == 0) {
+            submit_recv(sockfd);
+        } else {
+            submit_write(sockfd);
+        }
+    }
+}
+
+void uring_reactor::loop() {
+    bool stop_server = false;
+
+    submit_fixed(OP_ACCEPT);
+    submit_fixed(OP_SIGNAL);
+    submit_fixed(OP_COMPLETION);
+    submit_fixed(OP_TIMER);
+
+    while (!stop_server) {
+        std::vector<int> deferred;
+        deferred.swap(m_deferred);
+        for (size_t i = 0; i < deferred.size(); ++i) {
+            submit_fixed(deferred[i]);
+        }
+        //提交本轮产生的全部提交项,并等待至少一个完成项
+        int ret = m_ring.submit_and_wait(1);
+        if (ret < 0 && ret != -EINTR) {
+            LOG_ERROR("%s", "io_uring failure");
+            break;
+        }
+        uint64_t data;
+        int res;
+        unsigned flags;
+        while (m_ring.next_cqe(data, res, flags)) {
+            int op = (int)(data >> 56);
+            int sockfd = (int)(uint32_t)data;
+            unsigned gen = (unsigned)(data >> 32) & 0xffffff;
+            //旧连接迟到的完成项,只需归还它占用的provided buffer
+            if ((op == OP_RECV || op == OP_WRITE) && gen != (m_gen[sockfd] & 0xffffff)) {
+                int bid = uring::cqe_buffer(flags);
+                if (bid >= 0) {
+                    recycle_buffer(bid);
+                }
+                continue;
+            }
+            switch (op) {
+                case OP_ACCEPT: {
+                    dealwithaccept(res, flags);
+                    break;
+                }
+                case OP_RECV: {
+                    dealwithrecv(sockfd, res, flags);
+                    break;
+                }
+                case OP_WRITE: {
+                    dealwithwrite(sockfd, res);
+                    break;
+                }
+                case OP_SIGNAL: {
+                    if (!m_server->dealwithsignal(stop_server)) {
+                        LOG_ERROR("%s", "dealclientdata failure");
+                    }
+                    submit_fixed(OP_SIGNAL);
+                    break;
+                }
+                case OP_COMPLETION: {
+                    dealwithcompletion();
+                    submit_fixed(OP_COMPLETION);
+                    break;
+                }
+                case OP_TIMER: {
+                    uint64_t expirations;
+                    ::read(m_timerfd, &expirations, sizeof(expirations));
+                    m_armed = 0;
+                    submit_fixed(OP_TIMER);
+                    break;
+                }
+            }
+        }
+        resume_parked();
+        //最后处理定时事件,然后按新的最近到期时间设置timerfd
+        utils.timer_handler();
+        arm_timer();
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef URING_REACTOR_H
+#define URING_REACTOR_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <netinet/in.h>
+
+#include "../uring/uring.h"
+#include "../timer/lst_timer.h"
+#include "../threadpool/completion_queue.h"
+#include "../http/http_conn.h"
+
+class WebServer;
+
+//io_uring反应堆:accept、recv、writev都作为提交项批量交给内核,一次io_uring_enter同时完成提交和等待
+//工作线程只负责解析请求和填充应答,处理完后经完成队列交回本反应堆,由它提交下一次读或写
+class uring_reactor {
+public:
+    uring_reactor();
+    ~uring_reactor();
+
+    //内核不支持io_uring或provided buffer ring时返回false,由调用者回退到epoll
+    bool init(WebServer* server);
+    void loop();
+
+private:
+    //提交项的user_data:高8位为操作类型,中间24位为连接代数,低32位为文件描述符
+    enum OP_TYPE {
+        OP_ACCEPT = 1,
+        OP_RECV,
+        OP_WRITE,
+        OP_SIGNAL,
+        OP_COMPLETION,
+        OP_TIMER
+    };
+    uint64_t make_data(int op, int fd);
+
+    //不属于某个连接的提交项:accept和signalfd、完成队列、timerfd上的poll;提交队列放不下时记下,下一轮提交前重试
+    void submit_fixed(int op);
+    //以下两个在提交队列放不下时放弃该连接,返回false,调用者不能再使用该连接
+    bool submit_recv(int sockfd);
+    bool submit_write(int sockfd);
+    void abort_conn(int sockfd);
+    //归还provided buffer,并记下本轮归还的数量
+    void recycle_buffer(int bid);
+    //本轮有缓冲区归还时,为等待缓冲区的连接重新提交recv
+    void resume_parked();
+
+    void timer(int connfd, struct sockaddr_in client_address);
+    void adjust_timer(util_timer* timer);
+    void close_conn(int sockfd);
+    //按时间轮上最近的到期时间设置timerfd
+    void arm_timer();
+
+    void dealwithaccept(int res, unsigned flags);
+    void dealwithrecv(int sockfd, int res, unsigned flags);
+    void dealwithwrite(int sockfd, int res);
+    void dealwithcompletion();
+
+private:
+    WebServer* m_server;
+    int m_close_log;
+    uring m_ring;
+    completion_queue<http_conn> m_cq;   //工作线程处理完请求后投递
+    Utils utils;                        //定时器时间轮
+    int m_timerfd;          //io_uring_enter没有超时参数,由timerfd在最近的定时器到期时唤醒
+    uint64_t m_armed;       //timerfd当前设置的绝对到期时间(毫秒),0表示未设置
+
+    unsigned* m_gen;        //每个文件描述符上的连接代数,关闭时加1,用来丢弃旧连接迟到的完成项
+    bool* m_recving;        //该连接是否有recv正在内核中等待,或在m_parked中等待缓冲区
+    bool* m_aborted;        //abort_conn已shutdown该连接,等内核中的recv返回后关闭
+    std::deque<uint64_t> m_parked;     //recv因provided buffer用完而失败的连接,存放其OP_RECV的user_data
+    std::vector<int> m_deferred;       //提交队列放不下而推迟的submit_fixed操作
+    unsigned m_recycled;    //本轮归还的provided buffer数
+    bool m_multishot;       //内核是否支持multishot accept
+};
+
+#endif
@@ -2,8 +2,9 @@
 #include "webserver.h"
 
 WebServer::WebServer() {
-    //http_conn类对象
-    users = new http_conn[MAX_FD];
+    //连接表,连接对象在accept时才分配
+    m_conns = conn_table::get_instance();
+    m_conns->init();
 
     //root文件夹路径
     char server_path[200];
@@ -13,29 +14,49 @@ WebServer::WebServer() {
     strcpy(m_root, server_path);
     strcat(m_root, root);
 
-    //定时器
-    users_timer = new client_data[MAX_FD];
-
+    m_reactors = NULL;
+    m_next_reactor = 0;
+    m_uring = NULL;
+    m_connPool = NULL;
+    m_epollfd = -1;
+    m_sigfd = -1;
+
+    //SIGTERM改由signalfd接收,必须在创建日志、线程池等线程之前屏蔽,新线程会继承信号掩码
+    //SIGUSR1用于在运行中把连接池的统计写入日志
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
 }
 
 WebServer::~WebServer() {
-    close(m_epollfd);
+    delete[] m_reactors;
+    delete m_uring;
+    if (m_epollfd != -1) {
+        close(m_epollfd);
+    }
     close(m_listenfd);
-    close(m_pipefd[1]);
-    close(m_pipefd[0]);
-    delete[] users;
-    delete[] users_timer;
+    if (m_sigfd != -1) {
+        close(m_sigfd);
+    }
     delete m_pool;
-
+    //写完还在排队的注册用户
+    user_writer::get_instance()->stop();
+    if (m_connPool) {
+        m_connPool->LogStats();
+    }
 }
 
 void WebServer::init(int port, string user, string passWord, string databaseName, int log_write, 
-                     int opt_linger, int trigmode, int sql_num, int thread_num, int close_log, int actor_model)
+                     int opt_linger, int trigmode, int sql_min_num, int sql_num, int thread_num, int close_log, int actor_model, int reactor_num,
+                     string cache_control, int register_ack)
 {
     m_port = port;
     m_user = user;
     m_passWord = passWord;
     m_databaseName = databaseName;
+    m_sql_min_num = sql_min_num;
     m_sql_num = sql_num;
     m_thread_num = thread_num;
     m_log_write = log_write;
@@ -43,6 +64,9 @@ void WebServer::init(int port, string user, string passWord, string databaseName
     m_TRIGMode = trigmode;
     m_close_log = close_log;
     m_actormodel = actor_model;
+    m_reactor_num = reactor_num;
+    m_cache_control = cache_control;
+    m_register_ack = register_ack;
 }
 
 void WebServer::trig_mode() {
@@ -66,6 +90,28 @@ void WebServer::trig_mode() {
         m_LISTENTrigmode = 1;
         m_CONNTrigmode = 1;
     }
+    //io_uring,内核不支持时回退到LT + LT
+    else if (m_TRIGMode == 4) {
+        m_LISTENTrigmode = 0;
+        m_CONNTrigmode = 0;
+        m_uring = new uring_reactor;
+        if (!m_uring->init(this)) {
+            LOG_ERROR("%s", "io_uring unavailable, fall back to epoll LT + LT");
+            delete m_uring;
+            m_uring = NULL;
+            m_TRIGMode = 0;
+            return;
+        }
+        //读写都由io_uring完成,工作线程只做解析,因此固定使用proactor
+        if (m_actormodel == 1) {
+            LOG_INFO("%s", "io_uring backend uses proactor model");
+            m_actormodel = 0;
+        }
+        if (m_reactor_num > 0) {
+            LOG_INFO("%s", "io_uring backend runs a single reactor");
+            m_reactor_num = 0;
+        }
+    }
 
 }
 
@@ -83,17 +129,26 @@ void WebServer::log_write() {
 void WebServer::sql_pool() {
     //初始化数据库连接池
     m_connPool = connection_pool::GetInstance();
-    m_connPool->init("localhost", m_user, m_passWord, m_databaseName, 3306, m_sql_num, m_close_log);
+    m_connPool->init("localhost", m_user, m_passWord, m_databaseName, 3306, m_sql_min_num, m_sql_num, m_close_log);
     //初始化数据库读取表
-    users->initmysql_result(m_connPool);
+    http_conn::initmysql_result(m_connPool);
+    //注册用户的后台写入
+    user_writer::get_instance()->init(m_connPool, m_register_ack, m_close_log);
 }
 
 void WebServer::thread_pool() {
     //线程池
-    m_pool = new threadpool<http_conn>(m_actormodel, m_connPool, m_thread_num);
+    m_pool = new threadpool<http_conn>(m_actormodel, m_thread_num);
 }
 
 void WebServer::eventListen() {
+    //静态文件的Cache-Control规则,格式错误的条目被忽略
+    if (!cache_control::get_instance()->init(m_cache_control)) {
+        LOG_ERROR("invalid cache control rules: %s", m_cache_control.c_str());
+    }
+    LOG_INFO("request scanner: %s", char_scanner::name());
+    http_conn::init_routes();
+
     //网络编程基础步骤
     m_listenfd = socket(PF_INET, SOCK_STREAM, 0);       //创建监听socket文件描述符
     assert(m_listenfd >= 0);
@@ -123,66 +178,50 @@ void WebServer::eventListen() {
 
     utils.init(TIMESLOT);
 
+    utils.addsig(SIGPIPE, SIG_IGN);
+
+    //SIGTERM已在构造函数中屏蔽,这里通过signalfd把它变成可读事件,不再需要信号处理函数和管道
+    //定时任务由时间轮给出epoll_wait的超时时间,也不再依赖SIGALRM
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGUSR1);
+    m_sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    assert(m_sigfd != -1);
+
+    //io_uring后端不使用epoll,监听socket和signalfd都由uring_reactor提交给内核
+    if (m_uring) {
+        return;
+    }
+
     //epoll创建内核事件表
-    epoll_event events[MAX_EVENT_NUMBER];       //用于存储epoll事件表中就绪事件的event数组 
     m_epollfd = epoll_create(5);            //创建一个额外的文件描述符来唯一标识内核中的epoll事件表 
     assert(m_epollfd != -1);
 
     utils.addfd(m_epollfd, m_listenfd, false, m_LISTENTrigmode);       //主线程往epoll内核事件表中注册监听socket事件，当listen到新的客户连接时，m_listenfd变为就绪事件
-    http_conn::m_epollfd = m_epollfd;
-
-    ret = socketpair(PF_UNIX, SOCK_STREAM, 0, m_pipefd);
-    assert(ret != -1);
-    utils.setnonblocking(m_pipefd[1]);
-    utils.addfd(m_epollfd, m_pipefd[0], false, 0);
-
-    utils.addsig(SIGPIPE, SIG_IGN);
-    utils.addsig(SIGALRM, utils.sig_handler, false);
-    utils.addsig(SIGTERM, utils.sig_handler, false);
-
-    alarm(TIMESLOT);
-
-    //工具类,信号和描述符基础操作
-    Utils::u_pipefd = m_pipefd;
-    Utils::u_epollfd = m_epollfd;
-
+    utils.addfd(m_epollfd, m_sigfd, false, 0);
+
+    //单反应堆:主线程的epoll同时负责连接事件;多反应堆:每个子反应堆一个线程、一个epoll
+    if (m_reactor_num <= 0) {
+        m_reactors = new sub_reactor[1];
+        m_reactors[0].init(this, m_epollfd);
+    } else {
+        m_reactors = new sub_reactor[m_reactor_num];
+        for (int i = 0; i < m_reactor_num; ++i) {
+            m_reactors[i].init(this);
+            m_reactors[i].start();
+        }
+    }
 }
 
+//把新连接交给某个反应堆,由它初始化http_conn并创建定时器
 void WebServer::timer(int connfd, struct sockaddr_in client_address) {
-    users[connfd].init(connfd, client_address, m_root, m_CONNTrigmode, m_close_log, m_user, m_passWord, m_databaseName);
-    
-    //初始化client_data数据
-    //创建定时器，设置回调函数和超时时间，绑定用户数据，将定时器添加到链表中
-    users_timer[connfd].address = client_address;
-    users_timer[connfd].sockfd = connfd;
-    util_timer* timer = new util_timer;         //创建定时器临时变量
-    timer->user_data = &users_timer[connfd];    //设置定时器对应的连接资源
-    timer->cb_func = cb_func;                   //设置回调函数
-    time_t cur = time(NULL);
-    timer->expire = cur + 3 * TIMESLOT;          //设置绝对超时时间
-    users_timer[connfd].timer = timer;          //创建该连接对应的定时器，初始化为前述临时变量
-    utils.m_timer_lst.add_timer(timer);         //将该定时器添加到链表中
-
-}
-
-//若某个客户连接上有数据传输，则将定时器往后延迟3个单位
-//并对新的定时器在链表上的位置进行调整
-
-void WebServer::adjust_timer(util_timer* timer) {
-    time_t cur = time(NULL);
-    timer->expire = cur + 3 * TIMESLOT;
-    utils.m_timer_lst.adjust_timer(timer);
-
-    LOG_INFO("%s", "adjust timer once");
-}
-
-//处理定时器
-void WebServer::deal_timer(util_timer* timer, int sockfd) {
-    timer->cb_func(&users_timer[sockfd]);
-    if (timer) {
-        utils.m_timer_lst.del_timer(timer);
+    if (m_reactor_num <= 0) {
+        m_reactors[0].dispatch(connfd, client_address);
+        return;
     }
-    LOG_INFO("close fd %d", users_timer[sockfd].sockfd);
+    m_reactors[m_next_reactor].dispatch(connfd, client_address);
+    m_next_reactor = (m_next_reactor + 1) % m_reactor_num;
 }
 
 //处理新到的客户连接
@@ -196,7 +235,7 @@ bool WebServer::dealclinetdata() {
             LOG_ERROR("%s:errno is:%d", "accept error", errno);
             return false;
         }
-        if (http_conn::m_user_count >= MAX_FD) {
+        if (connfd >= m_conns->size() || http_conn::m_user_count >= m_conns->size()) {
             utils.show_error(connfd, "Internal server busy");
             LOG_ERROR("%s", "Internal server busy");
             return false;
@@ -212,7 +251,7 @@ bool WebServer::dealclinetdata() {
                 LOG_ERROR("%s:errno is:%d", "accept error", errno);
                 break;
             }
-            if (http_conn::m_user_count >= MAX_FD)
+            if (connfd >= m_conns->size() || http_conn::m_user_count >= m_conns->size())
             {
                 utils.show_error(connfd, "Internal server busy");
                 LOG_ERROR("%s", "Internal server busy");
@@ -225,111 +264,46 @@ bool WebServer::dealclinetdata() {
     return true;
 }
 
-//处理信号
-bool WebServer::dealwithsignal(bool& timeout, bool& stop_server) {
-    int ret = 0;
-    int sig;
-    char signals[1024];
-    ret = recv(m_pipefd[0], signals, sizeof(signals), 0);
+//处理信号,signalfd每次读出若干个完整的signalfd_siginfo
+bool WebServer::dealwithsignal(bool& stop_server) {
+    struct signalfd_siginfo info[16];
+    int ret = read(m_sigfd, info, sizeof(info));
     if (ret <= 0) {
         return false;
-    }  else {
-        for (int i = 0; i < ret; ++i) {
-            switch (signals[i]) {
-                case SIGALRM: {
-                    timeout = true;
-                    break;
-                }
-                case SIGTERM: {
-                    stop_server = true;
-                    break;
-                }
-            }
-        }
     }
-    return true;
-}
-
-//sockfd上有可读事件时，epoll_wait通知主线程处理
-void WebServer::dealwithread(int sockfd) {
-    util_timer* timer = users_timer[sockfd].timer;
-
-    //reactor
-    if (m_actormodel == 1) {
-        if (timer) {
-            adjust_timer(timer);
-        }
-        //若监测到读事件，将读取到的数据封装成一个请求对象并插入请求队列
-        m_pool->append(users + sockfd, 0);
-
-        while (true) {
-            if (users[sockfd].improv == 1) {
-                if (users[sockfd].timer_flag == 1) {
-                    deal_timer(timer, sockfd);
-                    users[sockfd].timer_flag = 0;
-                }
-                users[sockfd].improv = 0;
+    for (int i = 0; i < ret / (int)sizeof(info[0]); ++i) {
+        switch (info[i].ssi_signo) {
+            case SIGTERM: {
+                stop_server = true;
+                //退出前记录应答缓存的命中率
+                response_cache* cache = response_cache::get_instance();
+                LOG_INFO("response cache hits %llu of %llu lookups", (unsigned long long)cache->hits(),
+                         (unsigned long long)cache->lookups());
                 break;
             }
-        }
-    }
-    //proactor
-    else {
-        if (users[sockfd].read_once()) {
-            LOG_INFO("deal with the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
-            
-            m_pool->append_p(users + sockfd);
-            if (timer) {
-                adjust_timer(timer);
-            }
-
-        } else {
-            deal_timer(timer, sockfd);
-        }
-    }
-
-}
-
-//sockfd上有可写事件时，epoll_wait通知主线程。主线程往socket上写入服务器处理客户请求的结果
-void WebServer::dealwithwrite(int sockfd) {
-    util_timer* timer = users_timer[sockfd].timer;
-    //reactor
-    if (m_actormodel == 1) {
-        if (timer) {
-            adjust_timer(timer);
-        }
-        m_pool->append(users + sockfd, 1);
-        while (true) {
-            if (users[sockfd].improv == 1) {
-                if (users[sockfd].timer_flag == 1) {
-                    deal_timer(timer, sockfd);
-                    users[sockfd].timer_flag = 0;
+            case SIGUSR1: {
+                if (m_connPool) {
+                    m_connPool->LogStats();
                 }
-                users[sockfd].improv = 0;
                 break;
             }
         }
     }
-    //proacotr
-    else {
-        if (users[sockfd].write()) {
-            LOG_INFO("send data to the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
-            if (timer) {
-                adjust_timer(timer);
-            }
-        } 
-        else {
-            deal_timer(timer, sockfd);
-        }
-    }
+    return true;
 }
 
 void WebServer::eventLoop() {
-    bool timeout = false;
+    if (m_uring) {
+        m_uring->loop();
+        return;
+    }
+
     bool stop_server = false;
 
     while (!stop_server) {
-        int number = epoll_wait(m_epollfd, events, MAX_EVENT_NUMBER, -1);
+        //单反应堆模式下连接的定时器在主线程,等待时间取最近一个定时器的到期时间;多反应堆模式下主线程没有定时器
+        int timeout = (m_reactor_num <= 0) ? m_reactors[0].next_timeout() : -1;
+        int number = epoll_wait(m_epollfd, events, MAX_EVENT_NUMBER, timeout);
         if (number < 0 && errno != EINTR) {
             LOG_ERROR("%s", "epoll failure");
             break;
@@ -343,31 +317,21 @@ void WebServer::eventLoop() {
                     continue;
                 }
             }
-            else if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                //服务器端关闭连接，移除对应的定时器
-                util_timer* timer = users_timer[sockfd].timer;
-                deal_timer(timer, sockfd);
-            }
             //处理信号
-            else if ((sockfd == m_pipefd[0]) && (events[i].events & EPOLLIN)) {
-                bool flag = dealwithsignal(timeout, stop_server);
+            else if ((sockfd == m_sigfd) && (events[i].events & EPOLLIN)) {
+                bool flag = dealwithsignal(stop_server);
                 if (flag == false) {
                     LOG_ERROR("%s", "dealclientdata failure");
                 }
             }
-            //处理客户连接上接收到的数据
-            else if (events[i].events & EPOLLIN) {
-                dealwithread(sockfd);
-            }
-            else if (events[i].events & EPOLLOUT) {
-                dealwithwrite(sockfd);
+            //单反应堆模式下连接事件也注册在主线程的epoll上
+            else {
+                m_reactors[0].handle_event(events[i]);
             }
         }
-        //最后处理定时事件，因为I/O事件有更高的优先级。这样做将导致定时任务不能精确地按照预期的时间执行。
-        if (timeout) {
-            utils.timer_handler();
-            LOG_INFO("%s", "timer tick");
-            timeout = false;
+        //最后处理定时事件，因为I/O事件有更高的优先级。到期的任务最多推迟一轮事件处理的时间
+        if (m_reactor_num <= 0) {
+            m_reactors[0].tick();
         }
 
     }
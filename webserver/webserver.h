@@ -11,11 +11,15 @@
 #include <stdlib.h>
 #include <cassert>
 #include <sys/epoll.h>
+#include <sys/signalfd.h>
 
 #include "../threadpool/threadpool.h"
 #include "../http/http_conn.h"
+#include "../http/conn_table.h"
+#include "../http/cache_control.h"
+#include "sub_reactor.h"
+#include "uring_reactor.h"
 
-const int MAX_FD = 65536;           //最大文件描述符
 const int MAX_EVENT_NUMBER = 10000; //最大事件数
 const int TIMESLOT = 5;             //最小超时单位
 
@@ -25,8 +29,9 @@ public:
     ~WebServer();
 
     void init(int port , string user, string passWord, string databaseName,
-              int log_write , int opt_linger, int trigmode, int sql_num,
-              int thread_num, int close_log, int actor_model);
+              int log_write , int opt_linger, int trigmode, int sql_min_num, int sql_num,
+              int thread_num, int close_log, int actor_model, int reactor_num, string cache_control,
+              int register_ack);
 
     void thread_pool();
     void sql_pool();
@@ -35,12 +40,8 @@ public:
     void eventListen();
     void eventLoop();
     void timer(int connfd, struct sockaddr_in client_address);
-    void adjust_timer(util_timer *timer);
-    void deal_timer(util_timer *timer, int sockfd);
     bool dealclinetdata();
-    bool dealwithsignal(bool& timeout, bool& stop_server);
-    void dealwithread(int sockfd);
-    void dealwithwrite(int sockfd);
+    bool dealwithsignal(bool& stop_server);
 
 public:
     //基础
@@ -49,17 +50,20 @@ public:
     int m_log_write;
     int m_close_log;
     int m_actormodel;
+    string m_cache_control;     //静态文件的Cache-Control规则
 
-    int m_pipefd[2];
+    int m_sigfd;        //signalfd,SIGTERM作为普通的可读事件交给事件循环
     int m_epollfd;
-    http_conn* users;
+    conn_table* m_conns;    //按文件描述符索引的连接表,大小由RLIMIT_NOFILE决定
 
     //数据库相关
     connection_pool* m_connPool;
     string m_user;          //登陆数据库用户名
     string m_passWord;      //登陆数据库密码
     string m_databaseName;  //使用数据库名
+    int m_sql_min_num;
     int m_sql_num;
+    int m_register_ack;     //注册的确认方式,见user_writer::ACK_MODE
 
     //线程池相关
     threadpool<http_conn>* m_pool;
@@ -75,10 +79,15 @@ public:
     int m_LISTENTrigmode;
     int m_CONNTrigmode;
 
-    //定时器相关
-    client_data* users_timer;
+    //定时器相关,每个连接的client_data由连接表和http_conn一起分配
     Utils utils;
 
+    //反应堆相关,m_reactor_num为0时主线程兼做唯一的反应堆
+    int m_reactor_num;
+    sub_reactor* m_reactors;
+    int m_next_reactor;     //轮询分发新连接
+    uring_reactor* m_uring; //io_uring后端,为NULL时使用epoll
+
 };
 
 #endif
\ No newline at end of file